@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -8,10 +8,17 @@
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
 // * After changing buffer data, call bwrite to write it to disk.
+//     The write is delayed (write-back): the block is marked dirty
+//     and reaches the disk when the buf is recycled, when it has
+//     been dirty for BFLUSHTICKS, or on bflush().
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// With RAMDISK a buf holds no copy of the block: disk_read()
+// points b->data into the ramdisk image, so the bufs are small
+// descriptors that only provide the per-block lock.
 
 
 
@@ -24,76 +31,178 @@
 #include "include/buf.h"
 #include "include/printf.h"
 #include "include/disk.h"
+#include "include/kalloc.h"
+#include "include/proc.h"
+#include "include/sysinfo.h"
+#include "include/timer.h"
+
+#define NBUCKET      31
+#define BHASH(dev, sectorno) (((dev) * 7 + (sectorno)) % NBUCKET)
 
 struct {
   struct spinlock lock;
-  struct buf buf[NBUF];
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
+  // One list per hash bucket of (dev, sectorno), through
+  // prev/next, sorted by how recently the buffer was used.
   // head.next is most recent, head.prev is least.
-  struct buf head;
+  struct buf bucket[NBUCKET];
+
+  uint nbuf;
+  uint ndirty;
+  uint64 hits;
+  uint64 misses;
+  uint64 evictions;
+  uint64 writebacks;
 } bcache;
 
-void
-binit(void)
+// Add a page worth of bufs, up to NBUFMAX in all.
+// Returns the number of bufs added.
+static int
+bgrow(void)
 {
-  struct buf *b;
-
-  initlock(&bcache.lock, "bcache");
+  struct buf *page, *b, *head;
+  int n = PGSIZE / sizeof(struct buf);
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
+  if(bcache.nbuf + n > NBUFMAX)
+    n = NBUFMAX - bcache.nbuf;
+  if(n <= 0 || (page = kalloc()) == NULL)
+    return 0;
+  for(b = page; b < page + n; b++){
     b->refcnt = 0;
+    b->valid = 0;
+    b->dirty = 0;
     b->sectorno = ~0;
     b->dev = ~0;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    // never used, least recent
+    head = &bcache.bucket[(b - page) % NBUCKET];
+    b->next = head;
+    b->prev = head->prev;
+    head->prev->next = b;
+    head->prev = b;
+  }
+  bcache.nbuf += n;
+  return n;
+}
+
+// Size the cache from free memory: about 1/64 of it,
+// no less than NBUF bufs and no more than NBUFMAX.
+void
+binit(void)
+{
+  struct buf *head;
+  uint64 want;
+
+  initlock(&bcache.lock, "bcache");
+
+  for(head = bcache.bucket; head < &bcache.bucket[NBUCKET]; head++){
+    head->prev = head;
+    head->next = head;
   }
+  bcache.nbuf = 0;
+  bcache.ndirty = 0;
+  bcache.hits = bcache.misses = bcache.evictions = 0;
+  bcache.writebacks = 0;
+  want = freemem_amount() / 64 / sizeof(struct buf);
+  if(want < NBUF)
+    want = NBUF;
+  while(bcache.nbuf < want && bgrow() > 0)
+    ;
   #ifdef DEBUG
-  printf("binit\n");
+  printf("binit: %d bufs\n", bcache.nbuf);
   #endif
 }
 
+// Write b to disk if it is dirty. b must not be locked by
+// the caller; it stays cached. Caller must have interrupts
+// off, they are turned on while the write sleeps.
+static void
+bsync(struct buf *b)
+{
+  b->refcnt++;
+  pop_off();
+  acquiresleep(&b->lock);
+  if(b->dirty){
+    disk_write(b);
+    b->dirty = 0;
+    push_off();
+    bcache.ndirty--;
+    bcache.writebacks++;
+    pop_off();
+  }
+  releasesleep(&b->lock);
+  push_off();
+  if(--b->refcnt == 0)
+    wakeup(&bcache);
+}
+
 // Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
+// If not found, allocate a buffer, recycling the least
+// recently used unused one, its own bucket's first. If all
+// are in use, grow the cache or wait for a brelse().
 // In either case, return locked buffer.
 static struct buf*
 bget(uint dev, uint sectorno)
 {
-  struct buf *b;
+  struct buf *b, *head, *dirty;
+  int i, miss = 0;
 
   push_off();
-
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->sectorno == sectorno){
-      b->refcnt++;
-      pop_off();
-      acquiresleep(&b->lock);
-      return b;
+  head = &bcache.bucket[BHASH(dev, sectorno)];
+  for(;;){
+    // Is the block already cached?
+    for(b = head->next; b != head; b = b->next){
+      if(b->dev == dev && b->sectorno == sectorno){
+        b->refcnt++;
+        if(!miss)
+          bcache.hits++;
+        pop_off();
+        acquiresleep(&b->lock);
+        return b;
+      }
+    }
+    if(!miss){
+      bcache.misses++;
+      miss = 1;
     }
-  }
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->sectorno = sectorno;
-      b->valid = 0;
-      b->refcnt = 1;
-      pop_off();
-      acquiresleep(&b->lock);
-      return b;
+    // Not cached.
+    dirty = 0;
+    for(i = 0; i < NBUCKET; i++){
+      struct buf *h = &bcache.bucket[(BHASH(dev, sectorno) + i) % NBUCKET];
+      for(b = h->prev; b != h; b = b->prev){
+        if(b->refcnt == 0 && !b->dirty)
+          goto found;
+        if(b->refcnt == 0 && dirty == 0)
+          dirty = b;
+      }
     }
+    if(bgrow() > 0)
+      continue;
+    if(dirty){
+      // only dirty ones are free, write one back and look again
+      bsync(dirty);
+      continue;
+    }
+    sleep(&bcache, &bcache.lock);
   }
-  panic("bget: no buffers");
+
+found:
+  if(b->valid)
+    bcache.evictions++;
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+  b->next = head->next;
+  b->prev = head;
+  head->next->prev = b;
+  head->next = b;
+  b->dev = dev;
+  b->sectorno = sectorno;
+  b->valid = 0;
+  b->refcnt = 1;
+  pop_off();
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -110,12 +219,85 @@ bread(uint dev, uint sectorno) {
   return b;
 }
 
-// Write b's contents to disk.  Must be locked.
+// Mark b's contents to be written to disk.  Must be locked.
+// Repeated writes of a block before it is flushed cost one
+// disk write.
 void 
 bwrite(struct buf *b) {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  disk_write(b);
+  if(b->dirty)
+    return;
+  push_off();
+  b->dirty = 1;
+  b->dirtytick = ticks;
+  bcache.ndirty++;
+  pop_off();
+}
+
+// Write one dirty buf that has been dirty since tick
+// before or earlier. Returns 0 if there is none.
+static int
+bflushone(uint64 before)
+{
+  struct buf *b, *head;
+
+  push_off();
+  for(head = bcache.bucket; head < &bcache.bucket[NBUCKET]; head++){
+    for(b = head->next; b != head; b = b->next){
+      if(b->dirty && b->dirtytick <= before){
+        bsync(b);
+        pop_off();
+        return 1;
+      }
+    }
+  }
+  pop_off();
+  return 0;
+}
+
+// Write all dirty bufs to disk.
+void
+bflush(void)
+{
+  while(bcache.ndirty > 0 && bflushone(~0UL))
+    ;
+}
+
+// Write bufs that have been dirty for BFLUSHTICKS or more.
+// Called from usertrap() on timer interrupts, in the
+// context of the interrupted process.
+void
+bflush_tick(void)
+{
+  if(bcache.ndirty == 0 || ticks < BFLUSHTICKS)
+    return;
+  while(bflushone(ticks - BFLUSHTICKS))
+    ;
+}
+
+// Write back the dirty cached bufs of blocks [sectorno,
+// sectorno+n) of dev, for a caller about to read those
+// blocks from the disk directly.
+void
+bsyncrange(uint dev, uint sectorno, uint n)
+{
+  struct buf *b, *head;
+
+  if(bcache.ndirty == 0)
+    return;
+  push_off();
+  for(uint s = sectorno; s < sectorno + n; s++){
+    head = &bcache.bucket[BHASH(dev, s)];
+    for(b = head->next; b != head; b = b->next){
+      if(b->dev == dev && b->sectorno == s){
+        if(b->dirty)
+          bsync(b);
+        break;
+      }
+    }
+  }
+  pop_off();
 }
 
 // Release a locked buffer.
@@ -132,12 +314,14 @@ brelse(struct buf *b)
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
+    struct buf *head = &bcache.bucket[BHASH(b->dev, b->sectorno)];
     b->next->prev = b->prev;
     b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->next = head->next;
+    b->prev = head;
+    head->next->prev = b;
+    head->next = b;
+    wakeup(&bcache);
   }
   
   pop_off();
@@ -157,4 +341,16 @@ bunpin(struct buf *b) {
   pop_off();
 }
 
-
+// Buffer cache counters, for sysinfo.
+void
+bstat(struct sysinfo *info)
+{
+  push_off();
+  info->nbuf = bcache.nbuf;
+  info->bhits = bcache.hits;
+  info->bmisses = bcache.misses;
+  info->bevictions = bcache.evictions;
+  info->bdirty = bcache.ndirty;
+  info->bwritebacks = bcache.writebacks;
+  pop_off();
+}
@@ -15,6 +15,8 @@
 #include "include/disk.h"
 #include "include/exception.h"
 #include "include/swap.h"
+#include "include/kalloc.h"
+#include "include/string.h"
 #include <stdbool.h>
 
 uint64 prng = 0x1111111111111111;
@@ -215,4 +217,56 @@ void
 set_leds(uint8 val)
 {
   writeb(val, LEDS_ADDR);
-}
\ No newline at end of file
+}
+
+// Print bytes/cycle of memmove, memset and memcmp for
+// 16 B, 512 B and 4 KB, aligned. Clocks are ACLINT ticks
+// (SYS_CLK), results are printed in hundredths.
+static void
+membench_print(char *name, uint n, int iters, uint64 clocks)
+{
+  uint64 bpc = (uint64)n * iters * 100 / (clocks ? clocks : 1);
+
+  printf("%s\t%d\t%d.", name, n, bpc / 100);
+  if(bpc % 100 < 10)
+    printf("0");
+  printf("%d\n", bpc % 100);
+}
+
+void
+membench(void)
+{
+  static uint sizes[] = { 16, 512, 4096 };
+  char *a, *b;
+  uint64 start;
+  int i, iters;
+  uint n;
+
+  if((a = kalloc()) == NULL || (b = kalloc()) == NULL)
+    panic("membench: kalloc");
+  memset(a, 0x5a, PGSIZE);
+  printf("OP\tBYTES\tBYTES/CYCLE\n");
+  for(int k = 0; k < NELEM(sizes); k++){
+    n = sizes[k];
+    iters = (64 * 1024) / n;
+
+    start = readq(ACLINT_S);
+    for(i = 0; i < iters; i++)
+      memmove(b, a, n);
+    membench_print("memmove", n, iters, readq(ACLINT_S) - start);
+
+    start = readq(ACLINT_S);
+    for(i = 0; i < iters; i++)
+      memset(b, i, n);
+    membench_print("memset", n, iters, readq(ACLINT_S) - start);
+
+    memmove(b, a, n);
+    start = readq(ACLINT_S);
+    for(i = 0; i < iters; i++)
+      if(memcmp(a, b, n) != 0)
+        panic("membench: memcmp");
+    membench_print("memcmp", n, iters, readq(ACLINT_S) - start);
+  }
+  kfree(a);
+  kfree(b);
+}
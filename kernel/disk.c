@@ -6,31 +6,80 @@
 #include "include/flash.h"
 #include "include/disk.h"
 #include "include/printf.h"
+#include "include/sysinfo.h"
+#include "include/string.h"
+
+#ifdef RAMDISK
+// The ramdisk is the disk: a buf's data points straight into
+// it, so bread() copies nothing and bwrite() only notes which
+// flash subsectors disk_flush() has to rewrite. Subsectors are
+// copied in from flash on their first disk_read(), so boot does
+// not wait for the whole image; with RAMDISK_PREFETCH the idle
+// scheduler loads the rest in the background.
+#define RAMDISK_BASE ((uint8*)(SYSTOP))
+#define NSUBSECTOR   ((FS_SIZE_SECS) / SUBSECTOR_SECS)
+#define SUBSECTOR(sectorno)  ((sectorno) * (BSIZE / SECTOR_SIZE_BYTES) / SUBSECTOR_SECS)
+static uint8 dirty[NSUBSECTOR / 8];   // subsectors written since the last flush
+static uint8 valid[NSUBSECTOR / 8];   // subsectors loaded from flash
+static uint nvalid;
+static uint64 nprefetched;            // queued subsectors loaded while idle
+static struct sleeplock load_lock;    // held while loading a subsector
+
+// Subsectors readahead asked for, loaded when the cpu is idle.
+#define NPREFETCH    16
+static struct {
+	uint sub[NPREFETCH];
+	uint head, tail;                  // tail - head are queued
+} pfq;
+
+// Copy subsector sub from flash into the ramdisk.
+static void
+load_subsector(int sub, int locked)
+{
+	int sec = sub * SUBSECTOR_SECS;
+
+	for(int i = 0; i < SUBSECTOR_SECS; i++, sec++){
+		if(locked)
+			flash_read_sector(RAMDISK_BASE + sec * SECTOR_SIZE_BYTES, sec);
+		else
+			flash_read_sector_no_lock(RAMDISK_BASE + sec * SECTOR_SIZE_BYTES, sec);
+	}
+	valid[sub / 8] |= 1 << (sub % 8);
+	nvalid++;
+}
+#endif
 
 void disk_init(void)
 {
 	flash_init();
 
     #ifdef RAMDISK
-	printf("loading ramdisk...");
-
-	uint8* dst = SYSTOP;
-	uint64 i = 0;
-	for(int sec = 0; sec < FS_SIZE_SECS; sec++){
-		flash_read_sector_no_lock(dst, sec);
-		draw_spinner(i, 2000);
-		i++;
-		dst += SECTOR_SIZE_BYTES;
-	}
-	printf("done\n");
-	 
+	initsleeplock(&load_lock, "ramdisk");
+	nvalid = 0;
 	#endif
 }
 
+#ifdef RAMDISK
+// Make sure subsector sub is in the ramdisk.
+static void
+need_subsector(uint sub)
+{
+    if((valid[sub / 8] & (1 << (sub % 8))) == 0){
+        // two readers must not both load it, the second
+        // could overwrite what a writer changed meanwhile
+        acquiresleep(&load_lock);
+        if((valid[sub / 8] & (1 << (sub % 8))) == 0)
+            load_subsector(sub, 1);
+        releasesleep(&load_lock);
+    }
+}
+#endif
+
 void disk_read(struct buf *b)
 {   
     #ifdef RAMDISK
-    memmove(b->data, SYSTOP + BSIZE * b->sectorno, BSIZE);
+    need_subsector(SUBSECTOR(b->sectorno));
+    b->data = RAMDISK_BASE + BSIZE * b->sectorno;
     #else
 	flash_read_sector(b->data, b->sectorno * 2);
     flash_read_sector(b->data + BSIZE/2, b->sectorno * 2 + 1);
@@ -40,32 +89,177 @@ void disk_read(struct buf *b)
 void disk_write(struct buf *b)
 {
     #ifdef RAMDISK
-    memmove(SYSTOP + BSIZE * b->sectorno, b->data, BSIZE);
+    // b->data already is the ramdisk
+    uint sub = SUBSECTOR(b->sectorno);
+    dirty[sub / 8] |= 1 << (sub % 8);
     #else
 	flash_write_sector(b->data, b->sectorno * 2);
     flash_write_sector(b->data + BSIZE/2, b->sectorno * 2 + 1);
     #endif
 }
 
-void disk_flush()
+#ifdef RAMDISK
+// Rewrite subsector sub of the flash from the ramdisk.
+static void
+flush_subsector(int sub, int locked)
+{
+	int sec = sub * SUBSECTOR_SECS;
+
+	dirty[sub / 8] &= ~(1 << (sub % 8));
+	if(locked){
+		flash_erase_subsector(sec * SECTOR_SIZE_BYTES);
+		for(int i = 0; i < SUBSECTOR_SECS; i++, sec++)
+			flash_write_sector(RAMDISK_BASE + sec * SECTOR_SIZE_BYTES, sec);
+	} else {
+		flash_erase_subsector_no_lock(sec * SECTOR_SIZE_BYTES);
+		for(int i = 0; i < SUBSECTOR_SECS; i++, sec++)
+			flash_write_sector_no_lock(RAMDISK_BASE + sec * SECTOR_SIZE_BYTES, sec);
+	}
+}
+#endif
+
+// Where sectors [sectorno, sectorno+n) can be read and written
+// directly, bypassing the buffer cache: the ramdisk, which the
+// bufs point into as well. Returns 0 without a ramdisk.
+uint8 *disk_map(uint sectorno, uint n)
+{
+    #ifdef RAMDISK
+    for(uint sub = SUBSECTOR(sectorno); sub <= SUBSECTOR(sectorno + n - 1); sub++)
+        need_subsector(sub);
+    return RAMDISK_BASE + BSIZE * sectorno;
+    #else
+    return 0;
+    #endif
+}
+
+// Read sectors [sectorno, sectorno+n) into dst, bypassing the
+// buffer cache. The caller must have written back the cached
+// bufs of those sectors, see bsyncrange().
+void disk_readn(uint8 *dst, uint sectorno, uint n)
 {
+    #ifdef RAMDISK
+    memmove(dst, disk_map(sectorno, n), n * BSIZE);
+    #else
+    for(uint i = 0; i < n; i++, sectorno++, dst += BSIZE){
+        flash_read_sector(dst, sectorno * 2);
+        flash_read_sector(dst + BSIZE/2, sectorno * 2 + 1);
+    }
+    #endif
+}
+
+// Sectors [sectorno, sectorno+n) will be read soon: queue the
+// parts of the ramdisk not loaded yet for disk_idle(). Returns
+// 0 without a ramdisk, there is nothing to load them into
+// without sleeping.
+int disk_prefetch(uint sectorno, uint n)
+{
+    #ifdef RAMDISK
+    for(uint sub = SUBSECTOR(sectorno); sub <= SUBSECTOR(sectorno + n - 1); sub++){
+        if(valid[sub / 8] & (1 << (sub % 8)))
+            continue;
+        if(pfq.tail - pfq.head == NPREFETCH)
+            break;
+        if(pfq.tail != pfq.head && pfq.sub[(pfq.tail - 1) % NPREFETCH] == sub)
+            continue;
+        pfq.sub[pfq.tail++ % NPREFETCH] = sub;
+    }
+    return 1;
+    #else
+    return 0;
+    #endif
+}
+
+// Sectors [sectorno, sectorno+n) got written through disk_map().
+// Must be called after the data is in place.
+void disk_mark(uint sectorno, uint n)
+{
+    #ifdef RAMDISK
+    for(uint sub = SUBSECTOR(sectorno); sub <= SUBSECTOR(sectorno + n - 1); sub++)
+        dirty[sub / 8] |= 1 << (sub % 8);
+    #endif
+}
+
+// Write the ramdisk subsectors changed since the last flush
+// back to flash. Returns the number of bytes written.
+uint64 disk_flush()
+{
+	uint64 n = 0;
+
     #ifdef RAMDISK
     printf("\nflushing ramdisk to flash...");
 
-	// erase required subsectors first
-	for(int sec = 0; sec < FS_SIZE_SECS; sec += 16){
-		flash_erase_subsector(sec * SECTOR_SIZE_BYTES);
+	uint64 start = readq(ACLINT_S);
+	for(int sub = 0; sub < NSUBSECTOR; sub++){
+		if((dirty[sub / 8] & (1 << (sub % 8))) == 0)
+			continue;
+		flush_subsector(sub, 1);
+		draw_spinner(n++, 20);
+	}
+	printf("done, %d KB in %d ms\n",
+	       n * SUBSECTOR_SECS * SECTOR_SIZE_BYTES / 1024,
+	       (readq(ACLINT_S) - start) / (SYS_CLK / 1000));
+	n *= SUBSECTOR_SECS * SECTOR_SIZE_BYTES;
+    #endif
+	return n;
+}
+
+// Called by the scheduler when there is nothing to run: load
+// what readahead queued, else with RAMDISK_PREFETCH one more
+// subsector of the ramdisk, else with IDLEFLUSH write back one
+// dirty subsector so that a later disk_flush() has less to do.
+void disk_idle(void)
+{
+    #ifdef RAMDISK
+	if(flash_busy() || load_lock.locked)
+		return;
+
+	// one subsector a call, so a process that wakes up meanwhile
+	// does not wait behind the whole queue
+	while(pfq.head != pfq.tail){
+		uint sub = pfq.sub[pfq.head++ % NPREFETCH];
+		if((valid[sub / 8] & (1 << (sub % 8))) == 0){
+			load_subsector(sub, 0);
+			nprefetched++;
+			return;
+		}
+	}
+
+	#ifdef RAMDISK_PREFETCH
+	static int nextload;   // where the last scan stopped
+
+	for(; nvalid < NSUBSECTOR; nextload = (nextload + 1) % NSUBSECTOR){
+		if((valid[nextload / 8] & (1 << (nextload % 8))) == 0){
+			load_subsector(nextload, 0);
+			return;
+		}
 	}
+	#endif
+
+	#ifdef IDLEFLUSH
+	static int next;   // where the last scan stopped
 
-	uint8* src = SYSTOP;
-	uint64 i = 0;
-	for(int sec = 0; sec < FS_SIZE_SECS; sec++){
-		flash_write_sector(src, sec);
-		src += SECTOR_SIZE_BYTES;
-		i++;
-		draw_spinner(i, 2000);
+	for(int i = 0; i < NSUBSECTOR / 8; i++, next = (next + 8) % NSUBSECTOR){
+		uint8 bits = dirty[next / 8];
+		if(bits == 0)
+			continue;
+		for(int j = 0; j < 8; j++){
+			if(bits & (1 << j)){
+				flush_subsector(next + j, 0);
+				return;
+			}
+		}
 	}
-	printf("done\n");
+	#endif
+    #endif
+}
+
+// Readahead counters, for sysinfo.
+void disk_stat(struct sysinfo *info)
+{
+    #ifdef RAMDISK
+    info->raloads = nprefetched;
+    #else
+    info->raloads = 0;
     #endif
 }
 
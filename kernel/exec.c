@@ -11,38 +11,90 @@
 #include "include/fat32.h"
 #include "include/kalloc.h"
 #include "include/vm.h"
+#include "include/pcache.h"
 #include "include/printf.h"
 #include "include/string.h"
 #include "include/syspmu.h"
 
 
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
+// Map the program page at va (page aligned) of segment s of
+// program file ep into pagetable. File-backed pages come from
+// the program page cache and are shared with other processes
+// running the same binary: read-only, or copy-on-write if the
+// segment is writable. The rest of the segment is zero-filled.
 // Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct dirent *ep, uint offset, uint sz)
+int
+loadpage(pagetable_t pagetable, struct dirent *ep, struct segment *s, uint64 va)
 {
-  uint i, n;
-  uint64 pa;
+  uint64 off = va - s->vaddr;
+  uint n = 0;
+  char *mem;
+  int perm = s->perm;
+
   if((va % PGSIZE) != 0)
-    panic("loadseg: va must be page aligned");
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == NULL)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(eread(ep, 0, (uint64)pa, offset+i, n) != n)
+    panic("loadpage: va must be page aligned");
+
+  if(off < s->filesz){
+    n = (s->filesz - off < PGSIZE) ? s->filesz - off : PGSIZE;
+    if((mem = pcache_get(ep, s->off + off, n)) == NULL)
+      return -1;
+    if(perm & PTE_W)
+      perm = (perm & ~PTE_W) | PTE_COW;
+  } else {
+    if((mem = kzalloc()) == NULL)
       return -1;
   }
 
+  if(mappages(pagetable, va, PGSIZE, (uint64)mem, perm) != 0){
+    kfree(mem);
+    return -1;
+  }
+  // make sure i cache sees the new instructions
+  fence_i();
+  return 0;
+}
+
+// Map the pages of segment s that the program page cache
+// already holds, so a program run before starts without
+// faulting its image in again. A page an earlier segment
+// already mapped is left as it is.
+static int
+mapcached(pagetable_t pagetable, struct dirent *ep, struct segment *s)
+{
+  uint64 off;
+  uint n;
+  void *pa;
+  pte_t *pte;
+  int perm = s->perm;
+
+  if(perm & PTE_W)
+    perm = (perm & ~PTE_W) | PTE_COW;
+  for(off = 0; off < s->filesz; off += PGSIZE){
+    n = (s->filesz - off < PGSIZE) ? s->filesz - off : PGSIZE;
+    if((pte = walk(pagetable, s->vaddr + off, 0)) != NULL && (*pte & PTE_V))
+      continue;
+    if((pa = pcache_lookup(ep->first_clus, s->off + off, n)) == NULL)
+      continue;
+    if(mappages(pagetable, s->vaddr + off, PGSIZE, (uint64)pa, perm) != 0){
+      kfree(pa);
+      return -1;
+    }
+  }
   return 0;
 }
 
+static int
+flags2perm(int flags)
+{
+  int perm = PTE_R | PTE_U;
+
+  if(flags & ELF_PROG_FLAG_WRITE)
+    perm |= PTE_W;
+  if(flags & ELF_PROG_FLAG_EXEC)
+    perm |= PTE_X;
+  return perm;
+}
+
 
 int exec(char *path, char **argv)
 {
@@ -50,8 +102,10 @@ int exec(char *path, char **argv)
   int i, off;
   uint64 argc, sz = 0, sp, ustack[MAXARG+1], stackbase;
   struct elfhdr elf;
-  struct dirent *ep;
+  struct dirent *ep, *exe = 0, *oldexe;
   struct proghdr ph;
+  struct segment seg[NSEGMENT];
+  int nseg = 0;
   pagetable_t pagetable = 0, oldpagetable;
   pagetable_t kpagetable = 0, oldkpagetable;
   struct proc *p = myproc();
@@ -81,7 +135,9 @@ int exec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == NULL)
     goto bad;
 
-  // Load program into memory.
+  // Record the loadable segments. Pages the program page
+  // cache holds are mapped now, the others are read from
+  // the file on first touch, see lazyalloc().
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(eread(ep, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -91,17 +147,27 @@ int exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, kpagetable, sz, ph.vaddr + ph.memsz)) == 0)
-      goto bad;
-    sz = sz1;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loadseg(pagetable, ph.vaddr, ep, ph.off, ph.filesz) < 0)
+    if(ph.vaddr + ph.memsz >= FBUFFER_UVA)
+      goto bad;
+    if(nseg >= NSEGMENT)
+      goto bad;
+    seg[nseg].vaddr = ph.vaddr;
+    seg[nseg].filesz = ph.filesz;
+    seg[nseg].memsz = ph.memsz;
+    seg[nseg].off = ph.off;
+    seg[nseg].perm = flags2perm(ph.flags);
+    // raise sz first, so bad: frees what mapcached() maps
+    if(ph.vaddr + ph.memsz > sz)
+      sz = ph.vaddr + ph.memsz;
+    if(mapcached(pagetable, ep, &seg[nseg]) < 0)
       goto bad;
+    nseg++;
   }
   eunlock(ep);
-  eput(ep);
+  // keep the reference, the new image pages in from it
+  exe = ep;
   ep = 0;
 
   p = myproc();
@@ -165,7 +231,14 @@ int exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  oldexe = p->exe;
+  etextget(exe);
+  p->exe = exe;
+  p->nseg = nseg;
+  memmove(p->seg, seg, sizeof(seg));
   proc_freepagetable(oldpagetable, oldsz);
+  if(oldexe)
+    etextput(oldexe);
 
   w_satp(MAKE_SATP(p->kpagetable, procnum(p) * 2 + 1));
   sfence_vma_proc(procnum(p) * 2 + 2);
@@ -188,5 +261,7 @@ int exec(char *path, char **argv)
     eunlock(ep);
     eput(ep);
   }
+  if(exe)
+    eput(exe);
   return -1;
 }
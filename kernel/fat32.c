@@ -5,11 +5,15 @@
 #include "include/intr.h"
 #include "include/sleeplock.h"
 #include "include/buf.h"
+#include "include/disk.h"
 #include "include/proc.h"
 #include "include/stat.h"
 #include "include/fat32.h"
 #include "include/string.h"
 #include "include/printf.h"
+#include "include/pcache.h"
+#include "include/kalloc.h"
+#include "include/sysinfo.h"
 
 /* fields that start with "_" are something we don't use */
 
@@ -63,13 +67,45 @@ static struct {
 
 } fat;
 
+#define NEHASH      61
+#define NNEGENT     64      // names known not to exist
+#define NEGNAMELEN  32      // longer names aren't remembered missing
+
+// A name looked up in directory parent and not found.
+struct negent {
+    struct dirent *parent;  // 0 if unused
+    char    name[NEGNAMELEN];
+};
+
 static struct entry_cache {
     struct spinlock lock;
-    struct dirent entries[ENTRY_CACHE_NUM];
+    struct dirent *entries;
+    int     n;
+    struct dirent *hash[NEHASH];    // valid entries by parent and name
+    struct negent neg[NNEGENT];
+    int     negnext;                // next negent to replace
+    uint64  hits;                   // lookups found in the cache
+    uint64  neghits;                // ... found missing in the cache
+    uint64  misses;                 // ... that read the directory
 } ecache;
 
+static uint64 rabytes;      // bytes ereadahead() queued
+
 static struct dirent root;
 
+// Free-cluster bitmap, built from the FAT on the first allocation
+// so that boot does not read the whole FAT. Allocation is next-fit
+// from where the last one ended, preferring a cluster right after
+// the file's last one or else a run long enough for the write.
+static struct {
+    struct sleeplock lock;      // protects map, nfree and next
+    uint64  *map;               // bit set for each cluster in use
+    uint32  nfree;
+    uint32  next;               // where the next search starts
+} clusmap;
+
+#define CLUS_USED(c)    (clusmap.map[(c) / 64] & (1UL << ((c) % 64)))
+
 /**
  * Read the Boot Parameter Block.
  * @return  0       if success
@@ -115,6 +151,7 @@ int fat32_init()
 
 
     initlock(&ecache.lock, "ecache");
+    initsleeplock(&clusmap.lock, "clusmap");
     memset(&root, 0, sizeof(root));
     initsleeplock(&root.lock, "entry");
     root.attribute = (ATTR_DIRECTORY | ATTR_SYSTEM);
@@ -122,8 +159,31 @@ int fat32_init()
     root.valid = 1;
     root.prev = &root;
     root.next = &root;
-    for(struct dirent *de = ecache.entries; de < ecache.entries + ENTRY_CACHE_NUM; de++) {
+    // size the entry cache to the memory there is
+    int want = freemem_amount() / 64 / sizeof(struct dirent);
+    if (want > ENTRY_CACHE_MAX) {
+        want = ENTRY_CACHE_MAX;
+    }
+    if (want < ENTRY_CACHE_NUM) {
+        want = ENTRY_CACHE_NUM;
+    }
+    int order = 0;
+    while ((PGSIZE << order) < want * sizeof(struct dirent)) {
+        order++;
+    }
+    if ((ecache.entries = kalloc_pages(order)) == 0) {
+        panic("fat32_init: ecache");
+    }
+    ecache.n = (PGSIZE << order) / sizeof(struct dirent);
+    if (ecache.n > want) {      // keep ENTRY_CACHE_MAX a bound
+        ecache.n = want;
+    }
+    for(struct dirent *de = ecache.entries; de < ecache.entries + ecache.n; de++) {
         de->dev = 0;
+        de->hash = 0;
+        de->index = 0;
+        de->noindex = 0;
+        de->ntext = 0;
         de->valid = 0;
         de->ref = 0;
         de->dirty = 0;
@@ -164,6 +224,41 @@ static inline uint32 fat_offset_of_clus(uint32 cluster)
     return (cluster << 2) % fat.bpb.byts_per_sec;
 }
 
+// A few FAT sectors are kept decoded, so that following a chain
+// does not take a buffer cache lookup and sleeplock per hop.
+// Direct mapped; changes go to both the copy and the buffer,
+// which writes them back. sec is 0 for an empty slot, that is
+// never a FAT sector.
+#define NFATCACHE   8
+
+static struct {
+    uint32  sec[NFATCACHE];
+    uint32  ent[NFATCACHE][BSIZE / sizeof(uint32)];
+} fatcache;
+
+// Return the cached copy of FAT sector sec.
+static uint32 *fat_sector(uint32 sec)
+{
+    int i = sec % NFATCACHE;
+    if (fatcache.sec[i] != sec) {
+        struct buf *b = bread(0, sec);
+        memmove(fatcache.ent[i], b->data, BSIZE);
+        fatcache.sec[i] = sec;
+        brelse(b);
+    }
+    return fatcache.ent[i];
+}
+
+// Set entry idx of FAT sector sec held in b, which must be locked.
+static void fat_set(struct buf *b, uint32 sec, uint idx, uint32 content)
+{
+    ((uint32 *)b->data)[idx] = content;
+    if (fatcache.sec[sec % NFATCACHE] == sec) {
+        fatcache.ent[sec % NFATCACHE][idx] = content;
+    }
+    bwrite(b);
+}
+
 /**
  * Read the FAT table content corresponded to the given cluster number.
  * @param   cluster     the number of cluster which you want to read its content in FAT table
@@ -176,12 +271,8 @@ static uint32 read_fat(uint32 cluster)
     if (cluster > fat.data_clus_cnt + 1) {     // because cluster number starts at 2, not 0
         return 0;
     }
-    uint32 fat_sec = fat_sec_of_clus(cluster, 1);
-    // here should be a cache layer for FAT table, but not implemented yet.
-    struct buf *b = bread(0, fat_sec);
-    uint32 next_clus = *(uint32 *)(b->data + fat_offset_of_clus(cluster));
-    brelse(b);
-    return next_clus;
+    uint32 *ent = fat_sector(fat_sec_of_clus(cluster, 1));
+    return ent[fat_offset_of_clus(cluster) / sizeof(uint32)];
 }
 
 /**
@@ -196,9 +287,7 @@ static int write_fat(uint32 cluster, uint32 content)
     }
     uint32 fat_sec = fat_sec_of_clus(cluster, 1);
     struct buf *b = bread(0, fat_sec);
-    uint off = fat_offset_of_clus(cluster);
-    *(uint32 *)(b->data + off) = content;
-    bwrite(b);
+    fat_set(b, fat_sec, fat_offset_of_clus(cluster) / sizeof(uint32), content);
     brelse(b);
     return 0;
 }
@@ -215,58 +304,188 @@ static void zero_clus(uint32 cluster)
     }
 }
 
-static uint32 alloc_clus(uint8 dev)
+static void clusmap_build(void)
 {
-    // should we keep a free cluster list? instead of searching fat every time.
-    struct buf *b;
-    uint32 sec = fat.bpb.rsvd_sec_cnt;
+    uint32 const nclus = fat.data_clus_cnt + 2;
     uint32 const ent_per_sec = fat.bpb.byts_per_sec / sizeof(uint32);
-    for (uint32 i = 0; i < fat.bpb.fat_sz; i++, sec++) {
-        b = bread(dev, sec);
-        for (uint32 j = 0; j < ent_per_sec; j++) {
-            if (((uint32 *)(b->data))[j] == 0) {
-                ((uint32 *)(b->data))[j] = FAT32_EOC + 7;
-                bwrite(b);
-                brelse(b);
-                uint32 clus = i * ent_per_sec + j;
-                zero_clus(clus);
-                return clus;
+    uint32 words = (nclus + 63) / 64;
+    int order = 0;
+    while ((PGSIZE << order) < words * sizeof(uint64)) {
+        order++;
+    }
+    uint64 *map = kalloc_pages(order);
+    if (map == 0) {
+        panic("clusmap_build");
+    }
+    memset(map, 0, PGSIZE << order);
+    map[0] = 3;                     // clusters 0 and 1 don't exist
+    for (uint32 c = nclus; c < words * 64; c++) {
+        map[c / 64] |= 1UL << (c % 64);
+    }
+    clusmap.nfree = 0;
+    for (uint32 i = 0; i * ent_per_sec < nclus; i++) {
+        struct buf *b = bread(0, fat.bpb.rsvd_sec_cnt + i);
+        for (uint32 j = 0; j < ent_per_sec && i * ent_per_sec + j < nclus; j++) {
+            uint32 c = i * ent_per_sec + j;
+            if (c < 2) {
+                continue;
+            }
+            if (((uint32 *)(b->data))[j] != 0) {
+                map[c / 64] |= 1UL << (c % 64);
+            } else {
+                clusmap.nfree++;
             }
         }
         brelse(b);
     }
-    panic("no clusters");
+    clusmap.next = 2;
+    clusmap.map = map;
+}
+
+static void clusmap_init(void)
+{
+    if (clusmap.map == 0) {
+        acquiresleep(&clusmap.lock);
+        if (clusmap.map == 0) {
+            clusmap_build();
+        }
+        releasesleep(&clusmap.lock);
+    }
+}
+
+// First cluster of a run of want free ones in [from, to), 0 if
+// there is none. *any is set to the first free cluster seen.
+static uint32 clus_scan(uint32 from, uint32 to, uint want, uint32 *any)
+{
+    uint run = 0;
+    for (uint32 c = from; c < to; c++) {
+        if (c % 64 == 0 && clusmap.map[c / 64] == ~0UL) {    // a word all in use
+            run = 0;
+            c += 63;
+            continue;
+        }
+        if (CLUS_USED(c)) {
+            run = 0;
+            continue;
+        }
+        if (*any == 0) {
+            *any = c;
+        }
+        if (++run == want) {
+            return c - want + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Allocate and zero a cluster.
+ * @param   goal    the cluster wanted, if it is free, 0 for none
+ * @param   want    count of clusters the caller is about to need
+ */
+static uint32 alloc_clus(uint8 dev, uint32 goal, uint want)
+{
+    uint32 const nclus = fat.data_clus_cnt + 2;
+    uint32 clus, any = 0;
+
+    clusmap_init();
+    acquiresleep(&clusmap.lock);
+    if (goal >= 2 && goal < nclus && !CLUS_USED(goal)) {
+        clus = goal;
+    } else if ((clus = clus_scan(clusmap.next, nclus, want, &any)) == 0
+               && (clus = clus_scan(2, clusmap.next, want, &any)) == 0) {
+        clus = any;
+    }
+    if (clus == 0) {
+        panic("no clusters");
+    }
+    // claim it before write_fat() can sleep
+    clusmap.map[clus / 64] |= 1UL << (clus % 64);
+    clusmap.nfree--;
+    clusmap.next = clus + 1 < nclus ? clus + 1 : 2;
+    releasesleep(&clusmap.lock);
+    write_fat(clus, FAT32_EOC + 7);
+    zero_clus(clus);
+    return clus;
 }
 
 static void free_clus(uint32 cluster)
 {
+    // with the lock held a clusmap_build() either is done and
+    // the bit is cleared below, or has not started and reads 0
+    acquiresleep(&clusmap.lock);
     write_fat(cluster, 0);
+    if (clusmap.map != 0 && cluster >= 2 && CLUS_USED(cluster)) {
+        clusmap.map[cluster / 64] &= ~(1UL << (cluster % 64));
+        clusmap.nfree++;
+    }
+    releasesleep(&clusmap.lock);
 }
 
-static uint rw_clus(uint32 cluster, int write, int user, uint64 data, uint off, uint n)
+// Cluster and entry cache counts, for sysinfo.
+void fat32_stat(struct sysinfo *info)
 {
-    if (off + n > fat.byts_per_clus)
-        panic("offset out of range");
-    uint tot, m;
-    struct buf *bp;
-    uint sec = first_sec_of_clus(cluster) + off / fat.bpb.byts_per_sec;
-    off = off % fat.bpb.byts_per_sec;
+    clusmap_init();
+    info->nclus = fat.data_clus_cnt;
+    info->nfreeclus = clusmap.nfree;
+    info->ehits = ecache.hits;
+    info->eneghits = ecache.neghits;
+    info->emisses = ecache.misses;
+    info->rabytes = rabytes;
+}
 
+// Read or write n bytes from byte off of the contiguous sectors
+// starting at sec. Returns the bytes done. Runs of whole sectors
+// are copied straight from or to a mapped disk (the ramdisk); on
+// flash, whole-sector reads are read directly, a page at a time.
+// Everything else, such as directory entries and writes to flash,
+// goes through the buffer cache, which coalesces writes.
+static uint rw_secs(uint sec, int write, int user, uint64 data, uint off, uint n)
+{
+    uint tot, m, nsec;
+    struct buf *bp;
+    uint8 *p;
     int bad = 0;
-    for (tot = 0; tot < n; tot += m, off += m, data += m, sec++) {
-        bp = bread(0, sec);
-        m = BSIZE - off % BSIZE;
-        if (n - tot < m) {
-            m = n - tot;
-        }
-        if (write) {
-            if ((bad = either_copyin(bp->data + (off % BSIZE), user, data, m)) != -1) {
-                bwrite(bp);
+    sec += off / BSIZE;
+    off = off % BSIZE;
+
+    for (tot = 0; tot < n; tot += m, off = 0, data += m, sec += nsec) {
+        nsec = (n - tot) / BSIZE;
+        if (off == 0 && nsec > 0 && (p = disk_map(sec, nsec)) != 0) {
+            // the bufs point into the ramdisk too, so copying
+            // straight to or from it is coherent with them
+            m = nsec * BSIZE;
+            if (write) {
+                bad = either_copyin(p, user, data, m);
+                disk_mark(sec, nsec);
+            } else {
+                bad = either_copyout(user, data, p, m);
+            }
+        } else if (!write && off == 0 && nsec > 1 && (p = kalloc()) != 0) {
+            if (nsec > PGSIZE / BSIZE) {
+                nsec = PGSIZE / BSIZE;
             }
+            m = nsec * BSIZE;
+            bsyncrange(0, sec, nsec);       // the disk must be up to date
+            disk_readn(p, sec, nsec);
+            bad = either_copyout(user, data, p, m);
+            kfree(p);
         } else {
-            bad = either_copyout(user, data, bp->data + (off % BSIZE), m);
+            nsec = 1;
+            bp = bread(0, sec);
+            m = BSIZE - off;
+            if (n - tot < m) {
+                m = n - tot;
+            }
+            if (write) {
+                if ((bad = either_copyin(bp->data + off, user, data, m)) != -1) {
+                    bwrite(bp);
+                }
+            } else {
+                bad = either_copyout(user, data, bp->data + off, m);
+            }
+            brelse(bp);
         }
-        brelse(bp);
         if (bad == -1) {
             break;
         }
@@ -274,21 +493,115 @@ static uint rw_clus(uint32 cluster, int write, int user, uint64 data, uint off,
     return tot;
 }
 
+static uint rw_clus(uint32 cluster, int write, int user, uint64 data, uint off, uint n)
+{
+    if (off + n > fat.byts_per_clus)
+        panic("offset out of range");
+    return rw_secs(first_sec_of_clus(cluster), write, user, data, off, n);
+}
+
+// The extent map of an entry covers its clusters from index 0 up to
+// emap_end(). It is filled in as reloc_clus() walks the chain, so
+// seeking within the mapped part reads no FAT at all.
+static uint emap_end(struct dirent *entry)
+{
+    if (entry->nextent == 0) {
+        return 0;
+    }
+    struct extent *e = &entry->ext[entry->nextent - 1];
+    return e->idx + e->len;
+}
+
+// Record that cluster idx of the file is clus, if idx is just past
+// the mapped part and there is room.
+static void emap_add(struct dirent *entry, uint idx, uint32 clus)
+{
+    struct extent *e;
+    if (clus < 2 || clus >= FAT32_EOC || idx != emap_end(entry)) {
+        return;
+    }
+    if (entry->nextent > 0) {
+        e = &entry->ext[entry->nextent - 1];
+        if (e->clus + e->len == clus) {
+            e->len++;
+            return;
+        }
+    }
+    if (entry->nextent == NEXTENT) {
+        return;
+    }
+    e = &entry->ext[entry->nextent++];
+    e->idx = idx;
+    e->clus = clus;
+    e->len = 1;
+}
+
+// Cluster number of cluster idx of the file, 0 if it isn't mapped.
+static uint32 emap_find(struct dirent *entry, uint idx)
+{
+    int lo = 0, hi = entry->nextent - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        struct extent *e = &entry->ext[mid];
+        if (idx < e->idx) {
+            hi = mid - 1;
+        } else if (idx >= e->idx + e->len) {
+            lo = mid + 1;
+        } else {
+            return e->clus + (idx - e->idx);
+        }
+    }
+    return 0;
+}
+
+// Count of contiguous clusters from cur_clus on that are known
+// to belong to the file, at least 1.
+static uint emap_run(struct dirent *entry)
+{
+    uint idx = entry->clus_cnt;
+    for (int i = entry->nextent - 1; i >= 0; i--) {
+        struct extent *e = &entry->ext[i];
+        if (idx >= e->idx) {
+            return idx < e->idx + e->len ? e->idx + e->len - idx : 1;
+        }
+    }
+    return 1;
+}
+
 /**
  * for the given entry, relocate the cur_clus field based on the off
  * @param   entry       modify its cur_clus field
  * @param   off         the offset from the beginning of the relative file
- * @param   alloc       whether alloc new cluster when meeting end of FAT chains
+ * @param   alloc       count of clusters from off the caller is going to write,
+ *                      to alloc when meeting end of FAT chains, or 0
  * @return              the offset from the new cur_clus
  */
 static int reloc_clus(struct dirent *entry, uint off, int alloc)
 {
     int clus_num = off / fat.byts_per_clus;
+    uint32 clus;
+    if ((clus = emap_find(entry, clus_num)) != 0) {
+        entry->cur_clus = clus;
+        entry->clus_cnt = clus_num;
+        return off % fat.byts_per_clus;
+    }
+    // walk the chain from the end of the map, or from cur_clus
+    // if that is between there and the target
+    uint end = emap_end(entry);
+    if (end > 0 && (clus_num < entry->clus_cnt || entry->clus_cnt < end - 1)) {
+        entry->clus_cnt = end - 1;
+        entry->cur_clus = emap_find(entry, end - 1);
+    } else if (clus_num < entry->clus_cnt) {
+        entry->cur_clus = entry->first_clus;
+        entry->clus_cnt = 0;
+    }
+    emap_add(entry, entry->clus_cnt, entry->cur_clus);
     while (clus_num > entry->clus_cnt) {
-        int clus = read_fat(entry->cur_clus);
+        clus = read_fat(entry->cur_clus);
         if (clus >= FAT32_EOC) {
             if (alloc) {
-                clus = alloc_clus(entry->dev);
+                clus = alloc_clus(entry->dev, entry->cur_clus + 1,
+                                  clus_num - entry->clus_cnt + alloc - 1);
                 write_fat(entry->cur_clus, clus);
             } else {
                 entry->cur_clus = entry->first_clus;
@@ -298,17 +611,7 @@ static int reloc_clus(struct dirent *entry, uint off, int alloc)
         }
         entry->cur_clus = clus;
         entry->clus_cnt++;
-    }
-    if (clus_num < entry->clus_cnt) {
-        entry->cur_clus = entry->first_clus;
-        entry->clus_cnt = 0;
-        while (entry->clus_cnt < clus_num) {
-            entry->cur_clus = read_fat(entry->cur_clus);
-            if (entry->cur_clus >= FAT32_EOC) {
-                panic("reloc_clus");
-            }
-            entry->clus_cnt++;
-        }
+        emap_add(entry, entry->clus_cnt, clus);
     }
     return off % fat.byts_per_clus;
 }
@@ -327,37 +630,79 @@ int eread(struct dirent *entry, int user_dst, uint64 dst, uint off, uint n)
     uint tot, m;
     for (tot = 0; entry->cur_clus < FAT32_EOC && tot < n; tot += m, off += m, dst += m) {
         reloc_clus(entry, off, 0);
-        m = fat.byts_per_clus - off % fat.byts_per_clus;
+        // as far as the clusters are contiguous in one go
+        m = emap_run(entry) * fat.byts_per_clus - off % fat.byts_per_clus;
         if (n - tot < m) {
             m = n - tot;
         }
-        if (rw_clus(entry->cur_clus, 0, user_dst, dst, off % fat.byts_per_clus, m) != m) {
+        if (rw_secs(first_sec_of_clus(entry->cur_clus), 0, user_dst, dst,
+                    off % fat.byts_per_clus, m) != m) {
             break;
         }
     }
     return tot;
 }
 
+// Start bringing n bytes of entry from off into memory, for a
+// reader that is going to want them soon. The sectors are queued
+// for disk_idle(); without a ramdisk to load them into there is
+// no readahead, reading them here would only delay the reader.
+// Caller must hold entry->lock.
+void ereadahead(struct dirent *entry, uint off, uint n)
+{
+    if (off >= entry->file_size || (entry->attribute & ATTR_DIRECTORY)) {
+        return;
+    }
+    if (off + n > entry->file_size || off + n < off) {
+        n = entry->file_size - off;
+    }
+    uint32 cur_clus = entry->cur_clus;      // where eread() is
+    uint clus_cnt = entry->clus_cnt;
+    uint tot, m;
+    for (tot = 0; tot < n; tot += m, off += m) {
+        if (reloc_clus(entry, off, 0) < 0) {
+            break;
+        }
+        m = emap_run(entry) * fat.byts_per_clus - off % fat.byts_per_clus;
+        if (n - tot < m) {
+            m = n - tot;
+        }
+        uint sec = first_sec_of_clus(entry->cur_clus) + off % fat.byts_per_clus / BSIZE;
+        uint nsec = (off % BSIZE + m + BSIZE - 1) / BSIZE;
+        if (!disk_prefetch(sec, nsec)) {
+            break;
+        }
+        rabytes += m;
+    }
+    entry->cur_clus = cur_clus;
+    entry->clus_cnt = clus_cnt;
+}
+
 // Caller must hold entry->lock.
 int ewrite(struct dirent *entry, int user_src, uint64 src, uint off, uint n)
 {
     if (off > entry->file_size || off + n < off || (uint64)off + n > 0xffffffff
-        || (entry->attribute & ATTR_READ_ONLY)) {
+        || (entry->attribute & ATTR_READ_ONLY) || entry->ntext > 0) {
         return -1;
     }
     if (entry->first_clus == 0) {   // so file_size if 0 too, which requests off == 0
-        entry->cur_clus = entry->first_clus = alloc_clus(entry->dev);
+        entry->cur_clus = entry->first_clus =
+            alloc_clus(entry->dev, 0, (n + fat.byts_per_clus - 1) / fat.byts_per_clus);
         entry->clus_cnt = 0;
+        entry->nextent = 0;
         entry->dirty = 1;
     }
+    pcache_invalidate(entry->first_clus);
     uint tot, m;
     for (tot = 0; tot < n; tot += m, off += m, src += m) {
-        reloc_clus(entry, off, 1);
-        m = fat.byts_per_clus - off % fat.byts_per_clus;
+        reloc_clus(entry, off, (off % fat.byts_per_clus + n - tot + fat.byts_per_clus - 1)
+                               / fat.byts_per_clus);
+        m = emap_run(entry) * fat.byts_per_clus - off % fat.byts_per_clus;
         if (n - tot < m) {
             m = n - tot;
         }
-        if (rw_clus(entry->cur_clus, 1, user_src, src, off % fat.byts_per_clus, m) != m) {
+        if (rw_secs(first_sec_of_clus(entry->cur_clus), 1, user_src, src,
+                    off % fat.byts_per_clus, m) != m) {
             break;
         }
     }
@@ -370,6 +715,247 @@ int ewrite(struct dirent *entry, int user_src, uint64 src, uint off, uint n)
     return tot;
 }
 
+// Index of the names in a directory, built the first time the
+// directory is scanned and kept up to date by emake() and
+// eremove(). A lookup decodes only the entries whose name hash
+// matches; a create takes a free run without scanning.
+#define NDSLOT  256             // names per index, open addressing
+#define NDFREE  32              // free slot runs remembered
+
+struct dindex {
+    uint    end;                // offset of the unused tail of the dir
+    uint    nname;
+    uint    nfree;
+    struct {
+        uint    off;
+        uint    cnt;            // count of empty 32-byte slots
+    } free[NDFREE];
+    struct {
+        uint32  hash;           // 0 if never used, 1 if deleted
+        uint    off;            // offset of the name's first entry
+    } slot[NDSLOT];
+};
+
+static uint32 dhash(char *name)
+{
+    uint32 h = 2166136261;
+    while (*name) {
+        h = (h ^ (uchar)*name++) * 16777619;
+    }
+    return h < 2 ? h + 2 : h;
+}
+
+static int dindex_put(struct dindex *di, char *name, uint off)
+{
+    if (di->nname >= NDSLOT * 3 / 4) {
+        return -1;
+    }
+    uint32 h = dhash(name);
+    for (uint i = h % NDSLOT; ; i = (i + 1) % NDSLOT) {
+        if (di->slot[i].hash < 2) {
+            di->slot[i].hash = h;
+            di->slot[i].off = off;
+            di->nname++;
+            return 0;
+        }
+    }
+}
+
+static void dindex_free(struct dindex *di, uint off, uint cnt)
+{
+    if (di->nfree < NDFREE) {
+        di->free[di->nfree].off = off;
+        di->free[di->nfree].cnt = cnt;
+        di->nfree++;
+    }
+}
+
+static void dindex_drop(struct dirent *dp)
+{
+    if (dp->index) {
+        kfree(dp->index);
+        dp->index = 0;
+    }
+}
+
+// Scan dp once to index it, using ep to decode entries.
+static void dindex_build(struct dirent *dp, struct dirent *ep)
+{
+    struct dindex *di = kalloc();
+    if (di == 0) {
+        return;
+    }
+    memset(di, 0, sizeof(*di));
+    int count = 0, type;
+    uint off = 0;
+    while ((type = enext(dp, ep, off, &count)) != -1) {
+        if (type == 0) {
+            dindex_free(di, off, count);
+        } else if (dindex_put(di, ep->filename, off) < 0) {
+            kfree(di);
+            dp->noindex = 1;
+            return;
+        }
+        off += count << 5;
+    }
+    di->end = off;
+    dp->index = di;
+}
+
+// Offset of name in dp, decoded into ep, or -1.
+static int dindex_find(struct dirent *dp, struct dirent *ep, char *name)
+{
+    struct dindex *di = dp->index;
+    uint32 h = dhash(name);
+    uint i = h % NDSLOT;
+    for (int n = 0; n < NDSLOT && di->slot[i].hash != 0; n++, i = (i + 1) % NDSLOT) {
+        int count = 0;
+        if (di->slot[i].hash == h && enext(dp, ep, di->slot[i].off, &count) == 1
+            && strncmp(ep->filename, name, FAT32_MAX_FILENAME) == 0) {
+            return di->slot[i].off;
+        }
+    }
+    return -1;
+}
+
+// Where cnt free slots in dp are.
+static uint dindex_room(struct dindex *di, uint cnt)
+{
+    for (int i = 0; i < di->nfree; i++) {
+        if (di->free[i].cnt >= cnt) {
+            return di->free[i].off;
+        }
+    }
+    return di->end;
+}
+
+// name was written to cnt slots of dp from off.
+static void dindex_add(struct dirent *dp, char *name, uint off, uint cnt)
+{
+    struct dindex *di = dp->index;
+    for (int i = 0; i < di->nfree; i++) {
+        if (di->free[i].off == off) {
+            di->free[i].off += cnt << 5;
+            if ((di->free[i].cnt -= cnt) == 0) {
+                di->free[i] = di->free[--di->nfree];
+            }
+            break;
+        }
+    }
+    if (off + (cnt << 5) > di->end) {
+        di->end = off + (cnt << 5);
+    }
+    if (dindex_put(di, name, off) < 0) {
+        dindex_drop(dp);
+        dp->noindex = 1;
+    }
+}
+
+// The cnt slots of the name at off in dp were emptied.
+static void dindex_del(struct dirent *dp, uint off, uint cnt)
+{
+    struct dindex *di = dp->index;
+    for (int i = 0; i < NDSLOT; i++) {
+        if (di->slot[i].hash >= 2 && di->slot[i].off == off) {
+            di->slot[i].hash = 1;
+            di->nname--;
+            break;
+        }
+    }
+    dindex_free(di, off, cnt);
+}
+
+// Free the indexes of cached directories nobody holds, they are
+// built again on the next lookup. Called by kalloc() when it runs
+// out of memory. Returns the number of pages freed.
+int dindex_shrink(void)
+{
+    int n = 0;
+    push_off();
+    for (struct dirent *dp = ecache.entries; dp < ecache.entries + ecache.n; dp++) {
+        if (dp->ref == 0 && dp->index) {
+            dindex_drop(dp);
+            n++;
+        }
+    }
+    pop_off();
+    return n;
+}
+
+static uint ehash(struct dirent *parent, char *name)
+{
+    uint h = (uint64)parent >> 4;
+    while (*name) {
+        h = h * 31 + (uchar)*name++;
+    }
+    return h % NEHASH;
+}
+
+// Take entry out of the name hash. Caller must have interrupts off.
+static void ehash_remove(struct dirent *entry)
+{
+    if (entry->hash == 0) {
+        return;
+    }
+    struct dirent **pp = &ecache.hash[entry->hash - 1];
+    while (*pp != entry) {
+        pp = &(*pp)->hnext;
+    }
+    *pp = entry->hnext;
+    entry->hash = 0;
+}
+
+// Make a looked up or created entry valid and findable by
+// its parent and name.
+void evalid(struct dirent *entry)
+{
+    push_off();
+    ehash_remove(entry);
+    uint h = ehash(entry->parent, entry->filename);
+    entry->hnext = ecache.hash[h];
+    ecache.hash[h] = entry;
+    entry->hash = h + 1;
+    entry->valid = 1;
+    pop_off();
+}
+
+// Is name known not to exist in dp? Caller must have interrupts off.
+static struct negent *eneg_find(struct dirent *dp, char *name)
+{
+    for (struct negent *ng = ecache.neg; ng < ecache.neg + NNEGENT; ng++) {
+        if (ng->parent == dp && strncmp(ng->name, name, NEGNAMELEN) == 0) {
+            return ng;
+        }
+    }
+    return 0;
+}
+
+static void eneg_add(struct dirent *dp, char *name)
+{
+    if (strlen(name) >= NEGNAMELEN) {
+        return;
+    }
+    push_off();
+    if (eneg_find(dp, name) == 0) {
+        struct negent *ng = &ecache.neg[ecache.negnext];
+        ecache.negnext = (ecache.negnext + 1) % NNEGENT;
+        ng->parent = dp;
+        safestrcpy(ng->name, name, NEGNAMELEN);
+    }
+    pop_off();
+}
+
+// name now exists in dp.
+static void eneg_remove(struct dirent *dp, char *name)
+{
+    struct negent *ng;
+    push_off();
+    if ((ng = eneg_find(dp, name)) != 0) {
+        ng->parent = 0;
+    }
+    pop_off();
+}
+
 // Returns a dirent struct. If name is given, check ecache. It is difficult to cache entries
 // by their whole path. But when parsing a path, we open all the directories through it, 
 // which forms a linked list from the final file to the root. Thus, we use the "parent" pointer 
@@ -380,12 +966,13 @@ static struct dirent *eget(struct dirent *parent, char *name)
     struct dirent *ep;
     push_off();
     if (name) {
-        for (ep = root.next; ep != &root; ep = ep->next) {          // LRU algo
+        for (ep = ecache.hash[ehash(parent, name)]; ep != 0; ep = ep->hnext) {
             if (ep->valid == 1 && ep->parent == parent
                 && strncmp(ep->filename, name, FAT32_MAX_FILENAME) == 0) {
                 if (ep->ref++ == 0) {
                     ep->parent->ref++;
                 }
+                ecache.hits++;
                 pop_off();
                 // edup(ep->parent);
                 return ep;
@@ -394,12 +981,22 @@ static struct dirent *eget(struct dirent *parent, char *name)
     }
     for (ep = root.prev; ep != &root; ep = ep->prev) {              // LRU algo
         if (ep->ref == 0) {
+            ehash_remove(ep);
+            // it may have been a directory that negents point to
+            for (struct negent *ng = ecache.neg; ng < ecache.neg + NNEGENT; ng++) {
+                if (ng->parent == ep) {
+                    ng->parent = 0;
+                }
+            }
             ep->ref = 1;
             ep->dev = parent->dev;
             ep->off = 0;
             ep->valid = 0;
             ep->dirty = 0;
+            ep->nextent = 0;
+            ep->noindex = 0;
             pop_off();
+            dindex_drop(ep);
             return ep;
         }
     }
@@ -492,7 +1089,11 @@ void emake(struct dirent *dp, struct dirent *ep, uint off)
         panic("emake: not aligned");
     
     union dentry de;
+    uint start = off;
     memset(&de, 0, sizeof(de));
+    if (off > 32) {
+        eneg_remove(dp, ep->filename);
+    }
     if (off <= 32) {
         if (off == 0) {
             strncpy(de.sne.name, ".          ", sizeof(de.sne.name));
@@ -546,6 +1147,9 @@ void emake(struct dirent *dp, struct dirent *ep, uint off)
         de.sne.file_size = ep->file_size;                         // filesize is updated in eupdate()
         off = reloc_clus(dp, off, 1);
         rw_clus(dp->cur_clus, 1, 0, (uint64)&de, off, sizeof(de));
+        if (dp->index) {
+            dindex_add(dp, ep->filename, start, entcnt + 1);
+        }
     }
 }
 
@@ -579,14 +1183,14 @@ struct dirent *ealloc(struct dirent *dp, char *name, int attr)
     ep->filename[FAT32_MAX_FILENAME] = '\0';
     if (attr == ATTR_DIRECTORY) {    // generate "." and ".." for ep
         ep->attribute |= ATTR_DIRECTORY;
-        ep->cur_clus = ep->first_clus = alloc_clus(dp->dev);
+        ep->cur_clus = ep->first_clus = alloc_clus(dp->dev, 0, 1);
         emake(ep, ep, 0);
         emake(ep, dp, 32);
     } else {
         ep->attribute |= ATTR_ARCHIVE;
     }
     emake(dp, ep, off);
-    ep->valid = 1;
+    evalid(ep);
     eunlock(ep);
     return ep;
 }
@@ -601,6 +1205,26 @@ struct dirent *edup(struct dirent *entry)
     return entry;
 }
 
+// A process now runs the program in entry, which the caller
+// holds a reference on. Running processes page their image in
+// from the file, so until etextput() it can't be written.
+void etextget(struct dirent *entry)
+{
+    push_off();
+    entry->ntext++;
+    pop_off();
+}
+
+// A process no longer runs entry: drop what etextget() and
+// the reference taken with it.
+void etextput(struct dirent *entry)
+{
+    push_off();
+    entry->ntext--;
+    pop_off();
+    eput(entry);
+}
+
 // Only update filesize and first cluster in this case.
 // caller must hold entry->parent->lock
 void eupdate(struct dirent *entry)
@@ -637,6 +1261,12 @@ void eremove(struct dirent *entry)
         off += 32;
         off2 = reloc_clus(entry->parent, off, 0);
     }
+    if (entry->parent->index) {
+        dindex_del(entry->parent, entry->off, entcnt + 1);
+    }
+    push_off();
+    ehash_remove(entry);
+    pop_off();
     entry->valid = -1;
 }
 
@@ -644,6 +1274,7 @@ void eremove(struct dirent *entry)
 // caller must hold entry->lock
 void etrunc(struct dirent *entry)
 {
+    pcache_invalidate(entry->first_clus);
     for (uint32 clus = entry->first_clus; clus >= 2 && clus < FAT32_EOC; ) {
         uint32 next = read_fat(clus);
         free_clus(clus);
@@ -651,6 +1282,7 @@ void etrunc(struct dirent *entry)
     }
     entry->file_size = 0;
     entry->first_clus = 0;
+    entry->nextent = 0;
     entry->dirty = 1;
 }
 
@@ -759,6 +1391,7 @@ static void read_entry_info(struct dirent *entry, union dentry *d)
     entry->file_size = d->sne.file_size;
     entry->cur_clus = entry->first_clus;
     entry->clus_cnt = 0;
+    entry->nextent = 0;
 }
 
 /**
@@ -838,32 +1471,63 @@ struct dirent *dirlookup(struct dirent *dp, char *filename, uint *poff)
     if (dp->valid != 1) {
         return NULL;
     }
+    if (poff == 0) {
+        push_off();
+        if (eneg_find(dp, filename)) {
+            ecache.neghits++;
+            pop_off();
+            return NULL;
+        }
+        pop_off();
+    }
     struct dirent *ep = eget(dp, filename);
     if (ep->valid == 1) { 
         return ep; }                               // ecache hits
+    ecache.misses++;
 
     int len = strlen(filename);
     int entcnt = (len + CHAR_LONG_NAME - 1) / CHAR_LONG_NAME + 1;   // count of l-n-entries, rounds up. plus s-n-e
     int count = 0;
     int type;
     uint off = 0;
+    if (dp->index == 0 && !dp->noindex) {
+        dindex_build(dp, ep);
+    }
+    if (dp->index != 0) {
+        if ((type = dindex_find(dp, ep, filename)) >= 0) {
+            ep->parent = edup(dp);
+            ep->off = type;
+            evalid(ep);
+            return ep;
+        }
+        if (poff) {
+            *poff = dindex_room(dp->index, entcnt);
+        } else {
+            eneg_add(dp, filename);
+        }
+        eput(ep);
+        return NULL;
+    }
+    uint *room = poff;          // still looking for free slots
     reloc_clus(dp, 0, 0);
-    while ((type = enext(dp, ep, off, &count) != -1)) {
+    while ((type = enext(dp, ep, off, &count)) != -1) {
         if (type == 0) {
-            if (poff && count >= entcnt) {
-                *poff = off;
-                poff = 0;
+            if (room && count >= entcnt) {
+                *room = off;
+                room = 0;
             }
         } else if (strncmp(filename, ep->filename, FAT32_MAX_FILENAME) == 0) {
             ep->parent = edup(dp);
             ep->off = off;
-            ep->valid = 1;
+            evalid(ep);
             return ep;
         }
         off += count << 5;
     }
-    if (poff) {
-        *poff = off;
+    if (room) {
+        *room = off;
+    } else if (poff == 0) {
+        eneg_add(dp, filename);
     }
     eput(ep);
     return NULL;
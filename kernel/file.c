@@ -13,11 +13,15 @@
 #include "include/file.h"
 #include "include/pipe.h"
 #include "include/stat.h"
+#include "include/fcntl.h"
 #include "include/proc.h"
 #include "include/printf.h"
 #include "include/string.h"
 #include "include/vm.h"
 
+#define RAMIN   (4 * 1024)     // first readahead window
+#define RAMAX   (64 * 1024)    // largest readahead window
+
 extern int console_input_disabled;
 struct devsw devsw[NDEV];
 struct {
@@ -48,6 +52,9 @@ filealloc(void)
   for(f = ftable.file; f < ftable.file + NFILE; f++){
     if(f->ref == 0){
       f->ref = 1;
+      f->ranext = 0;
+      f->rawin = 0;
+      f->raend = 0;
       pop_off();
       return f;
     }
@@ -106,15 +113,24 @@ filestat(struct file *f, uint64 addr)
   struct proc *p = myproc();
   struct stat st;
   
-  if(f->type == FD_ENTRY){
-    elock(f->ep);
-    estat(f->ep, &st);
-    eunlock(f->ep);
-    if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+  switch(f->type){
+    case FD_ENTRY:
+      elock(f->ep);
+      estat(f->ep, &st);
+      eunlock(f->ep);
+      break;
+    case FD_PIPE:
+    case FD_DEVICE:
+      memset(&st, 0, sizeof(st));
+      st.type = f->type == FD_PIPE ? T_PIPE : T_DEVICE;
+      st.dev = f->type == FD_PIPE ? 0 : f->major;
+      break;
+    default:
       return -1;
-    return 0;
   }
-  return -1;
+  if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
 }
 
 // Read from file f.
@@ -138,8 +154,23 @@ fileread(struct file *f, uint64 addr, int n)
         break;
     case FD_ENTRY:
         elock(f->ep);
-          if((r = eread(f->ep, 1, addr, f->off, n)) > 0)
+          if((r = eread(f->ep, 1, addr, f->off, n)) > 0){
+            // read ahead of sequential readers, further each time
+            // asking only for the part of the window not asked for before
+            if(f->off == f->ranext){
+              f->rawin = f->rawin ? (f->rawin < RAMAX ? f->rawin * 2 : RAMAX) : RAMIN;
+            } else {
+              f->rawin = 0;
+              f->raend = 0;
+            }
             f->off += r;
+            f->ranext = f->off;
+            if(f->rawin && f->raend < f->off + f->rawin){
+              uint from = f->raend > f->off ? f->raend : f->off;
+              ereadahead(f->ep, from, f->off + f->rawin - from);
+              f->raend = f->off + f->rawin;
+            }
+          }
         eunlock(f->ep);
         break;
     default:
@@ -181,6 +212,67 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Move the offset of file f. Returns the new offset, or -1
+// if f can't seek or the offset is out of range. A directory
+// offset must fall on an entry (a multiple of 32).
+int64
+fileseek(struct file *f, int64 off, int whence)
+{
+  if(f->type != FD_ENTRY)
+    return -1;
+
+  elock(f->ep);
+  switch(whence){
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      off += f->off;
+      break;
+    case SEEK_END:
+      off += f->ep->file_size;
+      break;
+    default:
+      off = -1;
+  }
+  if(off < 0 || off > MAXFILEOFF
+     || ((f->ep->attribute & ATTR_DIRECTORY) && off % 32 != 0))
+    off = -1;
+  else
+    f->off = off;
+  eunlock(f->ep);
+  return off;
+}
+
+// Read from file f at offset off, leaving f->off alone.
+// addr is a user virtual address.
+int
+filepread(struct file *f, uint64 addr, int n, uint64 off)
+{
+  int r;
+
+  if(f->readable == 0 || f->type != FD_ENTRY || off > MAXFILEOFF)
+    return -1;
+  elock(f->ep);
+  r = eread(f->ep, 1, addr, off, n);
+  eunlock(f->ep);
+  return r;
+}
+
+// Write to file f at offset off, leaving f->off alone.
+// addr is a user virtual address.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint64 off)
+{
+  int r;
+
+  if(f->writable == 0 || f->type != FD_ENTRY || off > MAXFILEOFF)
+    return -1;
+  elock(f->ep);
+  r = ewrite(f->ep, 1, addr, off, n) == n ? n : -1;
+  eunlock(f->ep);
+  return r;
+}
+
 // Read from dir f.
 // addr is a user virtual address.
 int
@@ -188,7 +280,7 @@ dirnext(struct file *f, uint64 addr)
 {
   struct proc *p = myproc();
 
-  if(f->readable == 0 || !(f->ep->attribute & ATTR_DIRECTORY))
+  if(f->type != FD_ENTRY || f->readable == 0 || !(f->ep->attribute & ATTR_DIRECTORY))
     return -1;
 
   struct dirent de;
@@ -209,4 +301,49 @@ dirnext(struct file *f, uint64 addr)
     return -1;
 
   return 1;
-}
\ No newline at end of file
+}
+
+// Read as many entries of dir f as fit in n bytes at user
+// address addr, as struct dent records, from f->off on.
+// Returns the bytes filled, 0 at the end of the dir.
+int
+dirents(struct file *f, uint64 addr, int n)
+{
+  struct proc *p = myproc();
+
+  if(f->type != FD_ENTRY || f->readable == 0 || !(f->ep->attribute & ATTR_DIRECTORY))
+    return -1;
+
+  struct dirent de;
+  struct dent d;
+  int count, ret, len, tot = 0;
+  elock(f->ep);
+  for(;;){
+    count = 0;
+    while ((ret = enext(f->ep, &de, f->off, &count)) == 0) {  // skip empty entry
+      f->off += count * 32;
+    }
+    if (ret == -1)
+      break;
+    len = strlen(de.filename);
+    if(tot + DENTSIZE(len) > n){
+      if(tot == 0)
+        tot = -1;     // not even one fits
+      break;
+    }
+    d.size = de.file_size;
+    d.clus = de.first_clus;
+    d.reclen = DENTSIZE(len);
+    d.type = (de.attribute & ATTR_DIRECTORY) ? T_DIR : T_FILE;
+    if(copyout(p->pagetable, addr + tot, (char *)&d, sizeof(d)) < 0
+       || copyout(p->pagetable, addr + tot + sizeof(d), de.filename, len + 1) < 0){
+      if(tot == 0)    // else return those copied, this one comes next time
+        tot = -1;
+      break;
+    }
+    f->off += count * 32;
+    tot += d.reclen;
+  }
+  eunlock(f->ep);
+  return tot;
+}
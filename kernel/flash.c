@@ -126,7 +126,14 @@ void flash_erase_subsector(uint64 addr)
 {
 	// enter critical section!
 	acquiresleep(&flash_lock);
+	flash_erase_subsector_no_lock(addr);
+	releasesleep(&flash_lock);
+	// leave critical section!
+}
 
+
+void flash_erase_subsector_no_lock(uint64 addr)
+{
 	// erase subsector
 	writed(addr + FS_BASE_SECTOR * SECTOR_SIZE_BYTES, FLASH_CTRL + SUBSECTOR_ERASE_REG_V); 
 
@@ -136,9 +143,6 @@ void flash_erase_subsector(uint64 addr)
 
 	if((sret & 0b00100010) != 0)
 		panic("flash sector erase failed!");
-
-	releasesleep(&flash_lock);
-	// leave critical section!
 }
 
 
@@ -152,8 +156,13 @@ void flash_write_sector(uint8 *buf, int sectorno) {
 
 	// enter critical section!
 	acquiresleep(&flash_lock);
-	
+	flash_write_sector_no_lock(buf, sectorno);
+	releasesleep(&flash_lock);
+	// leave critical section!
+}
+
 
+void flash_write_sector_no_lock(uint8 *buf, int sectorno) {
 
 	#ifdef UNIFORM_TIMING
 	uint64 last_ticks = readq(ACLINT_S);
@@ -197,8 +206,12 @@ void flash_write_sector(uint8 *buf, int sectorno) {
 	#ifdef DEBUG
 	printf("done\n");
 	#endif
-	releasesleep(&flash_lock);
-	// leave critical section!
+}
+
+// Is a process using the flash? The _no_lock functions
+// may only be called when it is not.
+int flash_busy(void) {
+	return flash_lock.locked;
 }
 
 // A simple test for flash read/write test 
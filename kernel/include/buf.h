@@ -7,6 +7,8 @@
 
 struct buf {
   int valid;
+  int dirty;		// changed since it was last written to disk
+  uint64 dirtytick;	// ticks when it became dirty
   int disk;		// does disk "own" buf? 
   uint dev;
   uint sectorno;	// sector number 
@@ -14,12 +16,21 @@ struct buf {
   uint refcnt;
   struct buf *prev;
   struct buf *next;
+#ifdef RAMDISK
+  uchar *data;          // points into the ramdisk image, see disk_read()
+#else
   uchar data[BSIZE];
+#endif
 };
 
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bflush(void);
+void            bflush_tick(void);
+void            bsyncrange(uint, uint, uint);
+struct sysinfo;
+void            bstat(struct sysinfo*);
 
 #endif
@@ -65,6 +65,10 @@ int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
 int             dirnext(struct file *f, uint64 addr);
+int             dirents(struct file *f, uint64 addr, int n);
+int64           fileseek(struct file *f, int64 off, int whence);
+int             filepread(struct file *f, uint64 addr, int n, uint64 off);
+int             filepwrite(struct file *f, uint64 addr, int n, uint64 off);
 
 // fs.c
 // void            fsinit(int);
@@ -99,7 +103,7 @@ uint64          freemem_amount(void);
 // void            end_op(void);
 
 // pipe.c
-int             pipealloc(struct file**, struct file**);
+int             pipealloc(struct file**, struct file**, int);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
@@ -5,11 +5,19 @@
 
 #define FS_BASE_SECTOR 0x20200
 #define FS_SIZE_SECS 33 * 1024 * 4
+#define SUBSECTOR_SECS 16       // flash sectors per erase subsector
 
 void disk_init(void);
 void disk_read(struct buf *b);
 void disk_write(struct buf *b);
+uint8 *disk_map(uint sectorno, uint n);
+void disk_mark(uint sectorno, uint n);
+void disk_readn(uint8 *dst, uint sectorno, uint n);
+int disk_prefetch(uint sectorno, uint n);
 void disk_intr(void);
-void disk_flush(void);
+uint64 disk_flush(void);
+void disk_idle(void);
+struct sysinfo;
+void disk_stat(struct sysinfo *info);
 
 #endif
@@ -21,7 +21,18 @@
 
 #define FAT32_MAX_FILENAME  255
 #define FAT32_MAX_PATH      260
-#define ENTRY_CACHE_NUM     50
+#define ENTRY_CACHE_NUM     50      // least size of the entry cache
+#define ENTRY_CACHE_MAX     512     // most it is sized to at boot
+#define NEXTENT             16      // cluster runs mapped per entry
+
+// A run of contiguous clusters of a file.
+struct extent {
+    uint32  idx;            // index of the first cluster in the file
+    uint32  clus;           // its cluster number
+    uint32  len;            // count of clusters
+};
+
+struct dindex;
 
 struct dirent {
     char  filename[FAT32_MAX_FILENAME + 1];
@@ -37,6 +48,8 @@ struct dirent {
 
     uint32  cur_clus;
     uint    clus_cnt;
+    struct extent ext[NEXTENT];     // where the file's first clusters are
+    uint    nextent;
 
     /* for OS */
     uint8   dev;
@@ -47,6 +60,11 @@ struct dirent {
     struct dirent *parent;  // because FAT32 doesn't have such thing like inum, use this for cache trick
     struct dirent *next;
     struct dirent *prev;
+    struct dirent *hnext;   // hash chain of entries found by name
+    uint    hash;           // its bucket + 1, 0 if not in one
+    struct dindex *index;   // for a directory, its names by hash
+    uint8   noindex;        // too big to index
+    int     ntext;          // processes running it, see etextget()
     struct sleeplock    lock;
 };
 
@@ -56,6 +74,9 @@ char*           formatname(char *name);
 void            emake(struct dirent *dp, struct dirent *ep, uint off);
 struct dirent*  ealloc(struct dirent *dp, char *name, int attr);
 struct dirent*  edup(struct dirent *entry);
+void            etextget(struct dirent *entry);
+void            etextput(struct dirent *entry);
+void            evalid(struct dirent *entry);
 void            eupdate(struct dirent *entry);
 void            etrunc(struct dirent *entry);
 void            eremove(struct dirent *entry);
@@ -68,5 +89,9 @@ struct dirent*  ename(char *path);
 struct dirent*  enameparent(char *path, char *name);
 int             eread(struct dirent *entry, int user_dst, uint64 dst, uint off, uint n);
 int             ewrite(struct dirent *entry, int user_src, uint64 src, uint off, uint n);
+void            ereadahead(struct dirent *entry, uint off, uint n);
+int             dindex_shrink(void);
+struct sysinfo;
+void            fat32_stat(struct sysinfo *info);
 
 #endif
\ No newline at end of file
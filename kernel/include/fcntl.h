@@ -4,3 +4,10 @@
 #define O_APPEND  0x004
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+// lseek whence
+#define SEEK_SET  0
+#define SEEK_CUR  1
+#define SEEK_END  2
+
+#define MAXFILEOFF 0xffffffffUL  // FAT32 files are smaller than 4 GB
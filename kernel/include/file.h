@@ -9,6 +9,9 @@ struct file {
   struct pipe *pipe; // FD_PIPE
   struct dirent *ep;
   uint off;          // FD_ENTRY
+  uint ranext;       // FD_ENTRY, where a sequential read goes on
+  uint rawin;        // FD_ENTRY, readahead window in bytes
+  uint raend;        // FD_ENTRY, where readahead asked up to
   short major;       // FD_DEVICE
 };
 
@@ -36,5 +39,9 @@ int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
 int             dirnext(struct file *f, uint64 addr);
+int             dirents(struct file *f, uint64 addr, int n);
+int64           fileseek(struct file *f, int64 off, int whence);
+int             filepread(struct file *f, uint64 addr, int n, uint64 off);
+int             filepwrite(struct file *f, uint64 addr, int n, uint64 off);
 
 #endif
\ No newline at end of file
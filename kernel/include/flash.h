@@ -17,6 +17,11 @@
 void flash_init(void);
 void flash_read_sector(uint8 *buf, int sectorno);
 void flash_write_sector(uint8 *buf, int sectorno);
+void flash_read_sector_no_lock(uint8 *buf, int sectorno);
+void flash_write_sector_no_lock(uint8 *buf, int sectorno);
+void flash_erase_subsector(uint64 addr);
+void flash_erase_subsector_no_lock(uint64 addr);
+int flash_busy(void);
 void test_flash(void);
 
 #endif
\ No newline at end of file
@@ -6,8 +6,16 @@
 
 void*           kalloc(void);
 void            kfree(void *);
+void*           kalloc_pages(int);
+void*           kzalloc(void);
+void            kzalloc_refill(void);
+uint64          kzalloc_pooled(void);
+void            kfree_pages(void *, int);
 void            kinit(void);
+void            kdup(void *);
+int             krefcnt(void *);
 uint64          freemem_amount(void);
+void            kfreeblocks(uint64 *);
 void* memset_d(void *dest, register int val, register size_t len);
 
 #endif
\ No newline at end of file
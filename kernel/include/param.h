@@ -10,7 +10,10 @@
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define NBUF         (MAXOPBLOCKS*3)  // least size of disk block cache
+#define NBUFMAX    1024  // most the disk block cache grows to
+#define BFLUSHTICKS  100  // ticks a block may stay dirty in the cache
+#define NPCACHE     256  // pages in the program page cache
 #define MAXPATH      260   // maximum file path name
 #define SYS_CLK      50000000
 #define INTERVAL     (SYS_CLK / 50) // timer interrupt interval
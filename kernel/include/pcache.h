@@ -0,0 +1,16 @@
+#ifndef __PCACHE_H
+#define __PCACHE_H
+
+#include "types.h"
+
+struct dirent;
+
+void            pcacheinit(void);
+void*           pcache_lookup(uint32, uint, uint);
+void*           pcache_get(struct dirent *, uint, uint);
+void            pcache_invalidate(uint32);
+int             pcache_shrink(void);
+struct sysinfo;
+void            pcache_stat(struct sysinfo *);
+
+#endif
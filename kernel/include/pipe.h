@@ -5,18 +5,21 @@
 #include "spinlock.h"
 #include "file.h"
 
-#define PIPESIZE 512
+#define PIPEMAXORDER 4   // largest ring, 2^4 pages
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data;     // ring of size bytes, 2^order pages
+  uint size;
+  int order;
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
 };
 
-int pipealloc(struct file **f0, struct file **f1);
+void pipeinit(void);
+int pipealloc(struct file **f0, struct file **f1, int size);
 void pipeclose(struct pipe *pi, int writable);
 int pipewrite(struct pipe *pi, uint64 addr, int n);
 int piperead(struct pipe *pi, uint64 addr, int n);
@@ -42,6 +42,19 @@ extern struct cpu cpus[NCPU];
 
 enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+#define NSEGMENT      4  // loadable ELF segments per program
+
+// A loadable segment of the running program. exec() only
+// records it, lazyalloc() reads its pages from the program
+// file on first touch and zero-fills the bss part.
+struct segment {
+  uint64 vaddr;                // page aligned start address
+  uint64 filesz;               // bytes backed by the file
+  uint64 memsz;                // bytes in memory, beyond filesz is bss
+  uint64 off;                  // file offset of vaddr
+  int perm;                    // PTE_R/W/X/U from the ELF flags
+};
+
 struct pmu_mapping {
   int valid;
   uint64 event_code;
@@ -72,6 +85,10 @@ struct proc {
   struct dirent *cwd;          // Current directory
   char name[16];               // Process name (debugging)
   int tmask;                    // trace mask
+  uint64 lazyfaults;           // pages mapped on first touch
+  struct dirent *exe;          // program file backing seg[]
+  struct segment seg[NSEGMENT]; // demand-paged program segments
+  int nseg;
 
   // Consti was here 04.05.2025
   // --- Add PMU State ---
@@ -86,6 +103,8 @@ int             cpuid(void);
 void            exit(int);
 int             fork(void);
 int             growproc(int);
+int             lazyalloc(uint64);
+int             loadpage(pagetable_t, struct dirent *, struct segment *, uint64);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
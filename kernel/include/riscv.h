@@ -522,6 +522,7 @@ fence_i()
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
 #define PTE_S (1L << 8) // 1 -> page is swapped out 
+#define PTE_COW (1L << 9) // 1 -> shared copy-on-write page (RSW bit)
 #define PTE_G (1L << 5)
 #define PTE_A (1L << 6)
 #define PTE_D (1L << 7)
@@ -0,0 +1,13 @@
+#ifndef __SLAB_H
+#define __SLAB_H
+
+#include "types.h"
+
+struct kmem_cache;
+
+struct kmem_cache* kmem_cache_create(char *, uint, void (*)(void *));
+void*           kmem_cache_alloc(struct kmem_cache *);
+void            kmem_cache_free(struct kmem_cache *, void *);
+void            kmem_cache_dump(void);
+
+#endif
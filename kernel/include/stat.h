@@ -4,6 +4,7 @@
 #define T_DIR     1   // Directory
 #define T_FILE    2   // File
 #define T_DEVICE  3   // Device
+#define T_PIPE    4   // Pipe
 
 #define STAT_MAX_NAME 32
 
@@ -14,6 +15,18 @@ struct stat {
   uint64 size; // Size of file in bytes
 };
 
+// A directory entry as read by getdents(). Records are packed
+// one after the other, each reclen bytes long.
+struct dent {
+  uint64 size;    // Size of file in bytes
+  uint32 clus;    // First cluster, 0 if none
+  ushort reclen;  // Bytes of this record, name included
+  uchar type;     // Type of file
+  char name[];    // NUL-terminated
+};
+
+#define DENTSIZE(namelen) ((sizeof(struct dent) + (namelen) + 1 + 7) & ~7)
+
 // struct stat {
 //   int dev;     // File system's disk device
 //   uint ino;    // Inode number
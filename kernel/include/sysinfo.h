@@ -3,10 +3,29 @@
 
 #include "types.h"
 
+#define NORDER       10  // buddy allocator block sizes, 4 KB to 2 MB
+
 struct sysinfo {
   uint64 freemem;   // amount of free memory (bytes)
   uint64 nproc;     // number of process
   uint64 ticks;     // system uptime in INTERVALS
+  uint64 nfree[NORDER]; // free blocks of 2^i pages
+  uint64 nzero;     // free pages kept zeroed, not in nfree
+  uint64 nbuf;      // buffer cache size in blocks
+  uint64 bhits;     // buffer cache lookups found cached
+  uint64 bmisses;   // ... not found
+  uint64 bevictions; // cached blocks recycled for others
+  uint64 bdirty;    // cached blocks not yet written to disk
+  uint64 bwritebacks; // dirty blocks written to disk
+  uint64 nclus;     // file system data clusters
+  uint64 nfreeclus; // ... not in use
+  uint64 ehits;     // directory lookups found in the entry cache
+  uint64 eneghits;  // ... found missing in it
+  uint64 emisses;   // ... that read the directory
+  uint64 pchits;    // program pages found in the page cache
+  uint64 pcmisses;  // ... read from the program file
+  uint64 rabytes;   // file bytes queued for readahead
+  uint64 raloads;   // ramdisk subsectors loaded ahead while idle
 };
 
 
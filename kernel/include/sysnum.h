@@ -33,5 +33,10 @@
 
 #define SYS_pmu_setup   29 // Consti was here - 04.05.2025
 #define SYS_pmu_control 30 // Consti was here - 04.05.2025
+#define SYS_pipe2       31
+#define SYS_getdents    32
+#define SYS_lseek       33
+#define SYS_pread       34
+#define SYS_pwrite      35
 
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@ typedef unsigned char uint8;
 typedef unsigned short uint16;
 typedef unsigned int  uint32;
 typedef unsigned long uint64;
+typedef long int64;
 
 typedef unsigned long uintptr_t;
 typedef uint64 pde_t;
@@ -9,6 +9,7 @@ void            kvminithart(void);
 uint64          kvmpa(uint64);
 void            kvmmap(uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
+pte_t*          walk(pagetable_t, uint64, int);
 pagetable_t     uvmcreate(void);
 // void            uvminit(pagetable_t, uchar *, uint);
 void            uvminit(pagetable_t, pagetable_t, uchar *, uint);
@@ -16,8 +17,9 @@ uint64          uvmalloc(pagetable_t, pagetable_t, uint64, uint64);
 uint64          uvmdealloc(pagetable_t, pagetable_t, uint64, uint64);
 // int             uvmcopy(pagetable_t, pagetable_t, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, pagetable_t, uint64);
+int             uvmcow(pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
-// void            uvmunmap(pagetable_t, uint64, uint64, int);
+void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            vmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 uint64          walkaddr(pagetable_t, uint64);
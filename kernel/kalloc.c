@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or power-of-two blocks of contiguous pages.
 
 
 #include "include/types.h"
@@ -10,17 +11,32 @@
 #include "include/spinlock.h"
 #include "include/intr.h"
 #include "include/kalloc.h"
+#include "include/pcache.h"
+#include "include/fat32.h"
 #include "include/string.h"
 #include "include/printf.h"
-
-void freerange(void *pa_start, void *pa_end);
+#include "include/sysinfo.h"
 
 extern char kernel_end[]; // first address after kernel.
 
+// A free block of 2^order pages.
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
+// Reference counts for physical pages, one per page between
+// KERNBASE and PHYSTOP. Pages shared copy-on-write after fork()
+// go back to the freelist only when the last reference is dropped.
+// A block of several pages is counted on its first page.
+#define PA2PGREF(pa) (((uint64)(pa) - KERNBASE) >> PGSHIFT)
+#define PGREF2PA(i)  (KERNBASE + ((uint64)(i) << PGSHIFT))
+static uint16 pgref[(PHYSTOP - KERNBASE) / PGSIZE];
+
+// order + 1 of the free block starting at a page, 0 if the
+// page does not start a free block.
+static uint8 pgorder[(PHYSTOP - KERNBASE) / PGSIZE];
+
 void* memset_d(void *dest, register int val, register size_t len){
   register uint64 *ptr = (uint64*)dest;
   while (len-- > 0){
@@ -31,56 +47,225 @@ void* memset_d(void *dest, register int val, register size_t len){
 
 }
 
+// Buddy allocator. Free memory is kept in blocks of 2^order
+// pages, aligned to their size, on one circular list per
+// order. A block's buddy is the other half of the block of
+// the next order; freeing a block merges it with its buddy
+// as long as the buddy is free too.
+//
+// Pages from mark up to last have never been handed out and
+// are on no list. kinit() only sets mark; buddy_alloc() moves
+// it up a block at a time when the lists run dry, so boot
+// does not touch every page of memory.
 struct {
   struct spinlock lock;
-  struct run *freelist;
-  uint64 npage;
+  struct run freelist[NORDER];  // list heads
+  uint64 nfree[NORDER];         // free blocks per order
+  uint64 npage;                 // free pages on the lists
+  uint64 first, last;           // page numbers kalloc manages
+  uint64 mark;                  // first page never handed out
 } kmem;
 
+// Free pages the idle loop has already zeroed, handed out by
+// kzalloc(). They are counted as free memory but are not on
+// the buddy lists; each keeps the reference kalloc set.
+#define NZPOOL       16
+struct {
+  struct run *list;
+  uint64 n;
+} zpool;
+
+static void
+listadd(int order, struct run *r)
+{
+  struct run *h = &kmem.freelist[order];
+
+  r->next = h->next;
+  r->prev = h;
+  h->next->prev = r;
+  h->next = r;
+  pgorder[PA2PGREF(r)] = order + 1;
+  kmem.nfree[order]++;
+}
+
+static void
+listdel(int order, struct run *r)
+{
+  r->prev->next = r->next;
+  r->next->prev = r->prev;
+  pgorder[PA2PGREF(r)] = 0;
+  kmem.nfree[order]--;
+}
+
+// Order of the largest block aligned to its size
+// that starts at page i and ends by page end.
+static int
+fitorder(uint64 i, uint64 end)
+{
+  int order = NORDER - 1;
+
+  while(order > 0 && ((i & ((1L << order) - 1)) || i + (1L << order) > end))
+    order--;
+  return order;
+}
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
-  kmem.freelist = 0;
+  for(int i = 0; i < NORDER; i++){
+    kmem.freelist[i].next = kmem.freelist[i].prev = &kmem.freelist[i];
+    kmem.nfree[i] = 0;
+  }
   kmem.npage = 0;
-  freerange(kernel_end, (void*)SYSTOP);
+  kmem.first = PA2PGREF(PGROUNDUP((uint64)kernel_end));
+  kmem.last = PA2PGREF(SYSTOP);
+  kmem.mark = kmem.first;
   #ifdef DEBUG
   printf("kernel_end: %p, systop: %p\n", kernel_end, (void*)SYSTOP);
   printf("kinit\n");
   #endif
 }
 
+// Free the block of 2^order pages at pa, which normally should
+// have been returned by kalloc_pages(order).
+// A block with more than one reference only loses the
+// caller's reference.
 void
-freerange(void *pa_start, void *pa_end)
+kfree_pages(void *pa, int order)
 {
-  char *p;
-  p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  uint64 i, buddy;
+  int n = 1 << order;
+
+  if(order < 0 || order >= NORDER || ((uint64)pa - KERNBASE) % (PGSIZE << order) != 0
+     || PA2PGREF(pa) < kmem.first || PA2PGREF(pa) + n > kmem.mark)
+    panic("kfree");
+
+  push_off();
+  if(pgref[PA2PGREF(pa)] > 1){
+    pgref[PA2PGREF(pa)]--;
+    pop_off();
+    return;
+  }
+  pgref[PA2PGREF(pa)] = 0;
+  pop_off();
+
+  #ifdef KALLOC_JUNK
+  // Fill with junk to catch dangling refs.
+  memset_d(pa, 1, (PGSIZE << order) / 8);
+  #endif
+
+  push_off();
+  for(i = PA2PGREF(pa); order < NORDER - 1; order++){
+    buddy = i ^ (1L << order);
+    if(buddy < kmem.first || buddy + (1L << order) > kmem.last
+       || pgorder[buddy] != order + 1)
+      break;
+    listdel(order, (struct run*)PGREF2PA(buddy));
+    i &= ~(1L << order);
+  }
+  listadd(order, (struct run*)PGREF2PA(i));
+  kmem.npage += n;
+  pop_off();
 }
 
-// Free the page of physical memory pointed at by v,
+// Free the page of physical memory pointed at by pa,
 // which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// call to kalloc().
 void
 kfree(void *pa)
 {
-  struct run *r;
-  
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < kernel_end || (uint64)pa >= SYSTOP)
-    panic("kfree");
+  kfree_pages(pa, 0);
+}
 
-  // Fill with junk to catch dangling refs.
-  memset_d(pa, 1, PGSIZE/8);
+// Take a free block of 2^order pages off the buddy lists,
+// splitting a larger one if needed and taking new blocks from
+// past the mark. Returns 0 if none is free.
+static struct run *
+buddy_alloc(int order)
+{
+  struct run *r = 0;
+  int k;
+
+  push_off();
+  for(;;){
+    for(k = order; k < NORDER; k++){
+      if(kmem.nfree[k] > 0){
+        r = kmem.freelist[k].next;
+        listdel(k, r);
+        break;
+      }
+    }
+    if(r || kmem.mark == kmem.last)
+      break;
+    // lists are dry, take the next block past the mark
+    k = fitorder(kmem.mark, kmem.last);
+    listadd(k, (struct run*)PGREF2PA(kmem.mark));
+    kmem.mark += 1L << k;
+    kmem.npage += 1L << k;
+  }
+  if(r){
+    // split, putting the upper halves back
+    while(k > order){
+      k--;
+      listadd(k, (struct run*)((char*)r + (PGSIZE << k)));
+    }
+    kmem.npage -= 1 << order;
+    pgref[PA2PGREF(r)] = 1;
+  }
+  pop_off();
+  return r;
+}
 
-  r = (struct run*)pa;
+// Take a page from the zeroed pool, 0 if it is empty.
+// The page comes back with its reference already set.
+static struct run *
+zpool_take(void)
+{
+  struct run *r;
 
   push_off();
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  kmem.npage++;
+  r = zpool.list;
+  if(r){
+    zpool.list = r->next;
+    zpool.n--;
+  }
   pop_off();
+  if(r)
+    r->next = 0;    // the link was the only nonzero word
+  return r;
+}
+
+// Allocate a block of 2^order physically contiguous pages,
+// aligned to its size. Returns a pointer that the kernel can
+// use, or 0 if no block that large is free.
+void *
+kalloc_pages(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order >= NORDER)
+    return 0;
+
+  r = buddy_alloc(order);
+  if(r == NULL && order == 0)
+    r = zpool_take();
+
+  // out of memory, give back program pages nobody maps
+  // and the indexes of directories nobody holds
+  if(r == NULL && pcache_shrink() + dindex_shrink() > 0)
+    return kalloc_pages(order);
+
+  #ifdef DEBUG
+   if(r == NULL)
+    printf("kalloc_pages(%d): no more space\n", order);
+  #endif
+
+  #ifdef KALLOC_JUNK
+  if(r)
+    memset_d((char*)r, 1, (PGSIZE << order) / 8); // fill with junk
+  #endif
+  return (void*)r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -89,29 +274,108 @@ kfree(void *pa)
 void *
 kalloc(void)
 {
-  struct run *r;
+  struct run *r = 0;
 
+  // fast path, a single free page
   push_off();
-  r = kmem.freelist;
-  if(r) {
-    kmem.freelist = r->next;
+  if(kmem.nfree[0] > 0){
+    r = kmem.freelist[0].next;
+    listdel(0, r);
     kmem.npage--;
+    pgref[PA2PGREF(r)] = 1;
   }
   pop_off();
 
-  #ifdef DEBUG
-   //printf("kalloc(): %d left\n", kmem.npage);
-   if(r == NULL)
-    printf("kalloc(): no more space\n");
+  if(r == NULL)
+    return kalloc_pages(0);
+  #ifdef KALLOC_JUNK
+  memset_d((char*)r, 1, PGSIZE/8); // fill with junk
   #endif
-
-  if(r)
-    memset_d((char*)r, 1, PGSIZE/8); // fill with junk
   return (void*)r;
 }
 
+// Allocate one zeroed page, for page tables and user memory.
+// Takes a page the idle loop already cleared if there is one.
+// Returns 0 if the memory cannot be allocated.
+void *
+kzalloc(void)
+{
+  void *pa;
+
+  if((pa = zpool_take()) != NULL)
+    return pa;
+  if((pa = kalloc()) != NULL)
+    memset_d(pa, 0, PGSIZE/8);
+  return pa;
+}
+
+// Top up the zeroed page pool, called by the scheduler when
+// there is nothing to run. Only takes pages the buddy lists
+// have free; the program page cache is left alone.
+void
+kzalloc_refill(void)
+{
+  struct run *r;
+
+  while(zpool.n < NZPOOL && (r = buddy_alloc(0)) != NULL){
+    memset_d(r, 0, PGSIZE/8);
+    push_off();
+    r->next = zpool.list;
+    zpool.list = r;
+    zpool.n++;
+    pop_off();
+  }
+}
+
 uint64
 freemem_amount(void)
 {
-  return kmem.npage << PGSHIFT;
+  return (kmem.npage + (kmem.last - kmem.mark) + zpool.n) << PGSHIFT;
+}
+
+// Number of pre-zeroed free pages, for sysinfo.
+uint64
+kzalloc_pooled(void)
+{
+  return zpool.n;
+}
+
+// Add a reference to a page returned by kalloc(),
+// e.g. when fork() shares it copy-on-write.
+void
+kdup(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < kernel_end || (uint64)pa >= SYSTOP)
+    panic("kdup");
+
+  push_off();
+  if(pgref[PA2PGREF(pa)] < 1)
+    panic("kdup: free page");
+  pgref[PA2PGREF(pa)]++;
+  pop_off();
+}
+
+// Number of references to the page at pa.
+int
+krefcnt(void *pa)
+{
+  return pgref[PA2PGREF(pa)];
+}
+
+// Number of free blocks of each order, for sysinfo.
+void
+kfreeblocks(uint64 *nfree)
+{
+  uint64 i;
+  int order;
+
+  push_off();
+  for(order = 0; order < NORDER; order++)
+    nfree[order] = kmem.nfree[order];
+  // the blocks the pages past the mark will become
+  for(i = kmem.mark; i < kmem.last; i += 1L << order){
+    order = fitorder(i, kmem.last);
+    nfree[order]++;
+  }
+  pop_off();
 }
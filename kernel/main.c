@@ -8,6 +8,9 @@
 #include "include/console.h"
 #include "include/printf.h"
 #include "include/kalloc.h"
+#include "include/pcache.h"
+#include "include/pipe.h"
+#include "include/string.h"
 #include "include/timer.h"
 #include "include/trap.h"
 #include "include/proc.h"
@@ -70,10 +73,13 @@ main(unsigned long hartid, unsigned long dtb_pa)
   #ifdef SMALLDEBUG
   uartputc_sync(PRIMARY_UART, '4');
   #endif
+  uint64 boot_clk[2];   // clock at the start of each boot phase
+  boot_clk[0] = readq(ACLINT_S);
   kinit();         // physical page allocator
   #ifdef SMALLDEBUG
   uartputc_sync(PRIMARY_UART, '5');
   #endif
+  boot_clk[1] = readq(ACLINT_S);
   kvminit();       // create kernel page table
   #ifdef SMALLDEBUG
   uartputc_sync(PRIMARY_UART, '6');
@@ -104,6 +110,8 @@ main(unsigned long hartid, unsigned long dtb_pa)
   uartputc_sync(PRIMARY_UART, 'C');
   #endif
   fileinit();      // file table
+  pcacheinit();    // program page cache
+  pipeinit();      // pipe object cache
   #ifdef SMALLDEBUG
   uartputc_sync(PRIMARY_UART, 'D');
   #endif
@@ -116,6 +124,15 @@ main(unsigned long hartid, unsigned long dtb_pa)
   printf("hart %d init done\n", hartid);
   #endif
 
+  uint64 boot_done = readq(ACLINT_S);
+  printf("Boot: kinit %d us, other init %d us\n",
+         (boot_clk[1] - boot_clk[0]) / (SYS_CLK / 1000000),
+         (boot_done - boot_clk[1]) / (SYS_CLK / 1000000));
+
+  #ifdef MEMBENCH
+  membench();
+  #endif
+
   sbi_info();
 
   //sbi_test_pmu();
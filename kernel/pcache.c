@@ -0,0 +1,234 @@
+// Program page cache.
+//
+// Holds the file-backed pages of programs, keyed by the first
+// cluster of the program file and the file offset of the page.
+// exec() and loadpage() map these pages into every process
+// running the same binary, read-only or copy-on-write, so a
+// second launch of a program does no file I/O for its image.
+//
+// The cache owns one reference on each page (see kdup()). A page
+// whose only reference is the cache's can be dropped at any time:
+// kalloc() does so when it runs out of memory. Writing or
+// truncating a file drops its pages from the cache.
+//
+// kalloc() calls back in here, so the cache is guarded by
+// turning interrupts off rather than by a spinlock.
+
+
+#include "include/types.h"
+#include "include/param.h"
+#include "include/riscv.h"
+#include "include/spinlock.h"
+#include "include/intr.h"
+#include "include/sleeplock.h"
+#include "include/fat32.h"
+#include "include/kalloc.h"
+#include "include/pcache.h"
+#include "include/string.h"
+#include "include/printf.h"
+#include "include/sysinfo.h"
+
+#define NPCBUCKET    61
+#define NPCFILE      64
+
+struct pcpage {
+  uint32 clus;                 // first cluster of the file, 0 if unused
+  uint off;                    // file offset of the page
+  uint n;                      // bytes from the file, the rest is zero
+  void *pa;
+  struct pcpage *next;         // hash chain
+};
+
+struct {
+  struct pcpage page[NPCACHE];
+  struct pcpage *bucket[NPCBUCKET];
+  uint nfile[NPCFILE];         // cached pages of files by first cluster
+  uint64 hits;
+  uint64 misses;               // pages read from the file
+} pcache;
+
+#define PCHASH(clus, off)  (((clus) * 31 + ((off) >> PGSHIFT)) % NPCBUCKET)
+#define PCFILE(clus)       ((clus) % NPCFILE)
+
+void
+pcacheinit(void)
+{
+  for(int i = 0; i < NPCACHE; i++)
+    pcache.page[i].clus = 0;
+  for(int i = 0; i < NPCBUCKET; i++)
+    pcache.bucket[i] = 0;
+  for(int i = 0; i < NPCFILE; i++)
+    pcache.nfile[i] = 0;
+}
+
+// Caller must have interrupts off.
+static struct pcpage *
+pcfind(uint32 clus, uint off, uint n)
+{
+  struct pcpage *pp;
+
+  for(pp = pcache.bucket[PCHASH(clus, off)]; pp; pp = pp->next)
+    if(pp->clus == clus && pp->off == off && pp->n == n)
+      return pp;
+  return 0;
+}
+
+// Unlink pp from its chain and drop the cache's reference.
+// Caller must have interrupts off.
+static void
+pcdrop(struct pcpage *pp)
+{
+  struct pcpage **pn;
+
+  for(pn = &pcache.bucket[PCHASH(pp->clus, pp->off)]; *pn != pp; pn = &(*pn)->next)
+    ;
+  *pn = pp->next;
+  pcache.nfile[PCFILE(pp->clus)]--;
+  pp->clus = 0;
+  kfree(pp->pa);
+  pp->pa = 0;
+}
+
+// Look up the page holding n bytes of the file whose data starts
+// at cluster clus, from offset off. Returns the page with a
+// reference for the caller, or NULL if it is not cached.
+void *
+pcache_lookup(uint32 clus, uint off, uint n)
+{
+  struct pcpage *pp;
+  void *pa = 0;
+
+  if(clus == 0)
+    return 0;
+  push_off();
+  if((pp = pcfind(clus, off, n)) != 0){
+    pa = pp->pa;
+    kdup(pa);
+    pcache.hits++;
+  }
+  pop_off();
+  return pa;
+}
+
+// Return a page holding n bytes of program file ep from offset
+// off, zeroed beyond, with a reference for the caller. The page
+// comes from the cache or is read from the file and added.
+// Returns NULL if memory runs out or the file can't be read.
+void *
+pcache_get(struct dirent *ep, uint off, uint n)
+{
+  struct pcpage *pp, *free;
+  uint32 clus = ep->first_clus;
+  char *mem;
+  int locked;
+
+  if((mem = pcache_lookup(clus, off, n)) != NULL)
+    return mem;
+
+  if((mem = kalloc()) == NULL)
+    return NULL;
+  if(n < PGSIZE)
+    memset(mem + n, 0, PGSIZE - n);
+  if(n > 0){
+    push_off();
+    pcache.misses++;
+    pop_off();
+    // a read() of the program file itself may fault us in
+    // while already holding ep->lock
+    locked = holdingsleep(&ep->lock);
+    if(!locked)
+      elock(ep);
+    if(eread(ep, 0, (uint64)mem, off, n) != n){
+      if(!locked)
+        eunlock(ep);
+      kfree(mem);
+      return NULL;
+    }
+    // programs mostly fault their pages in order
+    ereadahead(ep, off + n, 4 * PGSIZE);
+    if(!locked)
+      eunlock(ep);
+  }
+  if(clus == 0)
+    return mem;
+
+  push_off();
+  // someone else may have read it while we slept
+  if((pp = pcfind(clus, off, n)) != 0){
+    kfree(mem);
+    mem = pp->pa;
+    kdup(mem);
+    pop_off();
+    return mem;
+  }
+  free = 0;
+  for(pp = pcache.page; pp < &pcache.page[NPCACHE]; pp++){
+    if(pp->clus == 0){
+      free = pp;
+      break;
+    }
+    if(free == 0 && krefcnt(pp->pa) == 1)
+      free = pp;
+  }
+  if(free){
+    if(free->clus)
+      pcdrop(free);
+    free->clus = clus;
+    free->off = off;
+    free->n = n;
+    free->pa = mem;
+    free->next = pcache.bucket[PCHASH(clus, off)];
+    pcache.bucket[PCHASH(clus, off)] = free;
+    pcache.nfile[PCFILE(clus)]++;
+    kdup(mem);
+  }
+  // else every cached page is in use, leave this one private
+  pop_off();
+  return mem;
+}
+
+// Drop all cached pages of the file starting at cluster clus,
+// its contents are about to change. Processes that map them
+// keep their own references.
+void
+pcache_invalidate(uint32 clus)
+{
+  struct pcpage *pp;
+
+  if(clus == 0)
+    return;
+  push_off();
+  // most writes are to files that are not programs
+  if(pcache.nfile[PCFILE(clus)] != 0){
+    for(pp = pcache.page; pp < &pcache.page[NPCACHE]; pp++)
+      if(pp->clus == clus)
+        pcdrop(pp);
+  }
+  pop_off();
+}
+
+// Free cached pages no process maps.
+// Returns the number of pages freed.
+int
+pcache_shrink(void)
+{
+  struct pcpage *pp;
+  int n = 0;
+
+  push_off();
+  for(pp = pcache.page; pp < &pcache.page[NPCACHE]; pp++){
+    if(pp->clus && krefcnt(pp->pa) == 1){
+      pcdrop(pp);
+      n++;
+    }
+  }
+  pop_off();
+  return n;
+}
+
+void
+pcache_stat(struct sysinfo *info)
+{
+  info->pchits = pcache.hits;
+  info->pcmisses = pcache.misses;
+}
@@ -9,24 +9,51 @@
 #include "include/file.h"
 #include "include/pipe.h"
 #include "include/kalloc.h"
+#include "include/slab.h"
+#include "include/string.h"
 #include "include/vm.h"
 
+static struct kmem_cache *pipecache;
+
+// Slab constructor, a free pipe keeps its initialised lock.
+static void
+pipector(void *obj)
+{
+  initlock(&((struct pipe*)obj)->lock, "pipe");
+}
+
+void
+pipeinit(void)
+{
+  pipecache = kmem_cache_create("pipe", sizeof(struct pipe), pipector);
+}
+
+// Make a pipe whose ring holds at least size bytes, rounded
+// up to a power-of-two number of pages; 0 means one page.
 int
-pipealloc(struct file **f0, struct file **f1)
+pipealloc(struct file **f0, struct file **f1, int size)
 {
   struct pipe *pi;
+  int order = 0;
 
   pi = 0;
   *f0 = *f1 = 0;
+  while(order <= PIPEMAXORDER && (PGSIZE << order) < size)
+    order++;
+  if(size < 0 || order > PIPEMAXORDER)
+    return -1;
   if((*f0 = filealloc()) == NULL || (*f1 = filealloc()) == NULL)
     goto bad;
-  if((pi = (struct pipe*)kalloc()) == NULL)
+  if((pi = kmem_cache_alloc(pipecache)) == NULL)
     goto bad;
+  if((pi->data = kalloc_pages(order)) == NULL)
+    goto bad;
+  pi->size = PGSIZE << order;
+  pi->order = order;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
-  initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
   (*f0)->writable = 0;
@@ -39,7 +66,7 @@ pipealloc(struct file **f0, struct file **f1)
 
  bad:
   if(pi)
-    kfree((char*)pi);
+    kmem_cache_free(pipecache, pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -60,21 +87,25 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     pop_off();
-    kfree((char*)pi);
+    kfree_pages(pi->data, pi->order);
+    kmem_cache_free(pipecache, pi);
   } else
     pop_off();
 }
 
+// Copies run in chunks up to the end of the ring; the reader
+// is woken once per batch, before the writer sleeps on a full
+// ring and when the write is done.
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
-  char ch;
+  int i, m;
+  uint off;
   struct proc *pr = myproc();
 
   push_off();
-  for(i = 0; i < n; i++){
-    while(pi->nwrite == pi->nread + PIPESIZE){  //DOC: pipewrite-full
+  for(i = 0; i < n; i += m){
+    while(pi->nwrite == pi->nread + pi->size){  //DOC: pipewrite-full
       if(pi->readopen == 0 || pr->killed){
         pop_off();
         return -1;
@@ -82,9 +113,15 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     }
-    if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    off = pi->nwrite & (pi->size - 1);
+    m = pi->size - (pi->nwrite - pi->nread);
+    if(m > pi->size - off)
+      m = pi->size - off;
+    if(m > n - i)
+      m = n - i;
+    if(copyin(pr->pagetable, pi->data + off, addr + i, m) == -1)
       break;
-    pi->data[pi->nwrite++ % PIPESIZE] = ch;
+    pi->nwrite += m;
   }
   wakeup(&pi->nread);
   pop_off();
@@ -94,9 +131,9 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m;
+  uint off;
   struct proc *pr = myproc();
-  char ch;
 
   push_off();
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -106,12 +143,16 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    off = pi->nread & (pi->size - 1);
+    m = pi->nwrite - pi->nread;
+    if(m > pi->size - off)
+      m = pi->size - off;
+    if(m > n - i)
+      m = n - i;
+    if(copyout(pr->pagetable, addr + i, pi->data + off, m) == -1)
       break;
+    pi->nread += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   pop_off();
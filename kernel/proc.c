@@ -8,6 +8,8 @@
 #include "include/proc.h"
 #include "include/intr.h"
 #include "include/kalloc.h"
+#include "include/disk.h"
+#include "include/slab.h"
 #include "include/printf.h"
 #include "include/string.h"
 #include "include/fat32.h"
@@ -162,6 +164,9 @@ found:
   }
 
   p->kstack = VKSTACK;
+  p->lazyfaults = 0;
+  p->exe = 0;
+  p->nseg = 0;
 
   // Consti was here 04.05.2025
   // --- Initialize PMU State --- 
@@ -359,11 +364,25 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
+    #ifdef LAZY_SBRK
+    // only reserve the range, lazyalloc() maps it on first touch
+    if(sz + n < sz || sz + n > FBUFFER_UVA)
+      return -1;
+    sz += n;
+    #else
     if((sz = uvmalloc(p->pagetable, p->kpagetable, sz, sz + n)) == 0) {
       return -1;
     }
+    #endif
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, p->kpagetable, sz, sz + n);
+    // memory given back is no longer backed by the program file
+    for(struct segment *s = p->seg; s < &p->seg[p->nseg]; s++){
+      if(s->vaddr + s->memsz > sz)
+        s->memsz = (sz > s->vaddr) ? sz - s->vaddr : 0;
+      if(s->filesz > s->memsz)
+        s->filesz = s->memsz;
+    }
     // clear tlb from all entries with this asid
     // this is probably more efficient and also should only occur rarely
     sfence_vma_proc(asid);
@@ -372,6 +391,45 @@ growproc(int n)
   return 0;
 }
 
+// Map the page at va of the current process on first touch.
+// Program pages are read from the program file, heap memory
+// that growproc() only reserved gets a zeroed page.
+// Called on page faults and from copyin/copyout.
+// Returns 0 on success, -1 if va is not such an address
+// or the page could not be filled.
+int
+lazyalloc(uint64 va)
+{
+  struct proc *p = myproc();
+  uint64 a = PGROUNDDOWN(va);
+  struct segment *s;
+  pte_t *pte;
+
+  if(va >= p->sz)
+    return -1;
+  // already mapped, e.g. the stack guard page
+  if((pte = walk(p->pagetable, a, 0)) != NULL && (*pte & PTE_V))
+    return -1;
+
+  for(s = p->seg; s < &p->seg[p->nseg]; s++){
+    if(a >= s->vaddr && a < s->vaddr + s->memsz){
+      if(loadpage(p->pagetable, p->exe, s, a) < 0)
+        return -1;
+      p->lazyfaults++;
+      return 0;
+    }
+  }
+
+  #ifdef LAZY_SBRK
+  if(uvmalloc(p->pagetable, p->kpagetable, a, a + PGSIZE) == 0)
+    return -1;
+  p->lazyfaults++;
+  return 0;
+  #else
+  return -1;
+  #endif
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -386,14 +444,23 @@ fork(void)
     return -1;
   }
 
-  // Copy user memory from parent to child.
+  // Share user memory copy-on-write with the child.
   if(uvmcopy(p->pagetable, np->pagetable, np->kpagetable, p->sz) < 0){
     freeproc(np);
     release(&np->lock);
+    sfence_vma_proc(procnum(p) * 2 + 2);
     return -1;
   }
+  // parent pages became read-only, drop its writable translations
+  sfence_vma_proc(procnum(p) * 2 + 2);
   np->sz = p->sz;
 
+  // the child pages in the same program on demand
+  if((np->exe = edup(p->exe)) != 0)
+    etextget(np->exe);
+  np->nseg = p->nseg;
+  memmove(np->seg, p->seg, sizeof(p->seg));
+
   np->parent = p;
 
   // copy tracing mask from parent.
@@ -476,6 +543,12 @@ exit(int status)
   eput(p->cwd);
   p->cwd = 0;
 
+  if(p->exe){
+    etextput(p->exe);
+    p->exe = 0;
+  }
+  p->nseg = 0;
+
   // Consti was here 04.05.2025
   // --- Clean up PMU state ---
   pmu_clear_config(p);
@@ -667,7 +740,11 @@ scheduler(void)
       release(&p->lock);
     }
     if (found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
+      // nothing to run; zero some free pages for later
+      // allocations and load or write back some of the ramdisk, then
+      // stop running on this core until an interrupt.
+      kzalloc_refill();
+      disk_idle();
       intr_on();
       asm volatile("wfi");
     }
@@ -875,7 +952,11 @@ procdump(void)
   struct proc *p;
   char *state;
 
+  #ifdef LAZY_SBRK
+  printf("\n ========= process list ==========\nPID\tSTATE\tNAME\tMEM\tPARENT\tLAZY\n");
+  #else
   printf("\n ========= process list ==========\nPID\tSTATE\tNAME\tMEM\tPARENT\n");
+  #endif
   for(p = procs; p < &procs[NPROC]; p++){
     if(p->state == UNUSED)
       continue;
@@ -892,10 +973,15 @@ procdump(void)
       print_size(p->sz);
       printf("\t-");
     }
+    #ifdef LAZY_SBRK
+    printf("\t%d", p->lazyfaults);
+    #endif
     printf("\n");
   }
   print_size(freemem_amount());
-  printf(" free\n =================================\n", freemem_amount() >> 10);
+  printf(" free\n");
+  kmem_cache_dump();
+  printf(" =================================\n");
 }
 
 uint64
@@ -0,0 +1,199 @@
+// Slab allocator for small kernel objects.
+//
+// A cache hands out objects of one size, carved from whole
+// pages taken from kalloc(). Each page (a slab) starts with a
+// struct slab and is followed by as many objects as fit; free
+// objects are chained through a link word stored just past
+// the object, so the object itself keeps its constructed state.
+//
+// Interface:
+// * kmem_cache_create() makes a named cache; the optional
+//     constructor runs once on every object of a new slab.
+// * kmem_cache_alloc() returns a constructed object.
+// * kmem_cache_free() gives it back; it should be returned
+//     in its constructed state.
+// * A slab whose objects are all free goes back to kalloc,
+//     unless it is the cache's last one with free objects.
+
+
+#include "include/types.h"
+#include "include/param.h"
+#include "include/riscv.h"
+#include "include/spinlock.h"
+#include "include/intr.h"
+#include "include/kalloc.h"
+#include "include/slab.h"
+#include "include/printf.h"
+
+#define NSLABCACHE   8
+
+struct slab {
+  struct slab *next;           // slabs of the cache with free objects
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void *freelist;              // first free object
+  uint inuse;                  // objects handed out
+};
+
+struct kmem_cache {
+  char *name;
+  uint size;                   // bytes per object slot, link included
+  uint perslab;                // objects per slab
+  void (*ctor)(void *);
+  struct slab partial;         // list head, slabs with free objects
+  uint npartial;
+  uint64 inuse;                // objects handed out
+  uint64 npage;                // slab pages
+  uint64 nalloc;               // kmem_cache_alloc() calls
+  uint64 nhit;                 // ... served without a new slab
+};
+
+static struct {
+  struct spinlock lock;
+  struct kmem_cache cache[NSLABCACHE];
+  int ncache;
+} slabs;
+
+// The free list link of an object.
+#define OBJLINK(c, obj)  (*(void**)((char*)(obj) + (c)->size - sizeof(void*)))
+
+// Create a cache for objects of size bytes.
+// Returns 0 if there is no room for another cache.
+struct kmem_cache *
+kmem_cache_create(char *name, uint size, void (*ctor)(void *))
+{
+  struct kmem_cache *c;
+
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  size += sizeof(void*);
+  if(size > PGSIZE - sizeof(struct slab))
+    panic("kmem_cache_create: object too big");
+
+  push_off();
+  if(slabs.ncache == 0)
+    initlock(&slabs.lock, "slabs");
+  if(slabs.ncache >= NSLABCACHE){
+    pop_off();
+    return 0;
+  }
+  c = &slabs.cache[slabs.ncache++];
+  pop_off();
+
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  c->ctor = ctor;
+  c->partial.next = c->partial.prev = &c->partial;
+  c->npartial = 0;
+  c->inuse = c->npage = c->nalloc = c->nhit = 0;
+  return c;
+}
+
+// Caller must have interrupts off.
+static void
+partial_add(struct kmem_cache *c, struct slab *s)
+{
+  s->next = c->partial.next;
+  s->prev = &c->partial;
+  c->partial.next->prev = s;
+  c->partial.next = s;
+  c->npartial++;
+}
+
+// Caller must have interrupts off.
+static void
+partial_del(struct kmem_cache *c, struct slab *s)
+{
+  s->prev->next = s->next;
+  s->next->prev = s->prev;
+  c->npartial--;
+}
+
+// A new slab with all its objects constructed and free.
+static struct slab *
+slab_grow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+
+  if((s = kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->freelist = 0;
+  obj = (char*)s + sizeof(struct slab) + (c->perslab - 1) * c->size;
+  for(; obj >= (char*)s + sizeof(struct slab); obj -= c->size){
+    if(c->ctor)
+      c->ctor(obj);
+    OBJLINK(c, obj) = s->freelist;
+    s->freelist = obj;
+  }
+  return s;
+}
+
+void *
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+  int hit = 1;
+
+  push_off();
+  if(c->npartial == 0){
+    pop_off();
+    if((s = slab_grow(c)) == 0)
+      return 0;
+    hit = 0;
+    push_off();
+    c->npage++;
+    partial_add(c, s);
+  }
+  s = c->partial.next;
+  obj = s->freelist;
+  s->freelist = OBJLINK(c, obj);
+  if(++s->inuse == c->perslab)
+    partial_del(c, s);
+  c->inuse++;
+  c->nalloc++;
+  c->nhit += hit;
+  pop_off();
+  return obj;
+}
+
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)obj);
+
+  if(s->cache != c || s->inuse == 0)
+    panic("kmem_cache_free");
+
+  push_off();
+  if(s->inuse-- == c->perslab)
+    partial_add(c, s);
+  OBJLINK(c, obj) = s->freelist;
+  s->freelist = obj;
+  c->inuse--;
+  if(s->inuse == 0 && c->npartial > 1){
+    partial_del(c, s);
+    c->npage--;
+  } else
+    s = 0;
+  pop_off();
+
+  if(s)
+    kfree(s);
+}
+
+// Print the statistics of all caches, for procdump().
+void
+kmem_cache_dump(void)
+{
+  struct kmem_cache *c;
+
+  printf("CACHE\tINUSE\tPAGES\tHIT%%\n");
+  for(c = slabs.cache; c < &slabs.cache[slabs.ncache]; c++){
+    printf("%s\t%d\t%d\t%d\n", c->name, c->inuse, c->npage,
+           c->nalloc ? c->nhit * 100 / c->nalloc : 100);
+  }
+}
@@ -9,6 +9,10 @@
 #include "include/syscall.h"
 #include "include/sysinfo.h"
 #include "include/kalloc.h"
+#include "include/buf.h"
+#include "include/fat32.h"
+#include "include/disk.h"
+#include "include/pcache.h"
 #include "include/vm.h"
 #include "include/string.h"
 #include "include/printf.h"
@@ -121,6 +125,11 @@ extern uint64 sys_flushdisk(void);
 extern uint64 sys_frame(void);
 extern uint64 sys_pmu_setup(void);
 extern uint64 sys_pmu_control(void);
+extern uint64 sys_pipe2(void);
+extern uint64 sys_getdents(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
 
 static uint64 (*syscalls[])(void) = {
   [SYS_fork]        sys_fork,
@@ -152,7 +161,12 @@ static uint64 (*syscalls[])(void) = {
   [SYS_flush_disk]  sys_flushdisk,
   [SYS_frame]       sys_frame,
   [SYS_pmu_setup]   sys_pmu_setup,
-  [SYS_pmu_control] sys_pmu_control
+  [SYS_pmu_control] sys_pmu_control,
+  [SYS_pipe2]       sys_pipe2,
+  [SYS_getdents]    sys_getdents,
+  [SYS_lseek]       sys_lseek,
+  [SYS_pread]       sys_pread,
+  [SYS_pwrite]      sys_pwrite,
 };
 
 static char *sysnames[] = {
@@ -186,6 +200,11 @@ static char *sysnames[] = {
   [SYS_frame]       "frame",
   [SYS_pmu_setup]   "pmu_setup",
   [SYS_pmu_control] "pmu_control",
+  [SYS_pipe2]       "pipe2",
+  [SYS_getdents]    "getdents",
+  [SYS_lseek]       "lseek",
+  [SYS_pread]       "pread",
+  [SYS_pwrite]      "pwrite",
 };
 
 void
@@ -230,6 +249,12 @@ sys_sysinfo(void)
   info.freemem = freemem_amount();
   info.nproc = procsnum();
   info.ticks = ticks;
+  kfreeblocks(info.nfree);
+  info.nzero = kzalloc_pooled();
+  bstat(&info);
+  fat32_stat(&info);
+  disk_stat(&info);
+  pcache_stat(&info);
 
   if (copyout(p->pagetable, addr, (char *)&info, sizeof(info)) < 0) {
     return -1;
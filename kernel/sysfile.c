@@ -17,6 +17,7 @@
 #include "include/pipe.h"
 #include "include/fcntl.h"
 #include "include/fat32.h"
+#include "include/buf.h"
 #include "include/syscall.h"
 #include "include/string.h"
 #include "include/printf.h"
@@ -101,6 +102,44 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  uint64 off;
+  int whence;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  return fileseek(f, (int64)off, whence);
+}
+
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n;
+  uint64 p, off;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0
+     || argaddr(3, &off) < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n;
+  uint64 p, off;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0
+     || argaddr(3, &off) < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
 uint64
 sys_close(void)
 {
@@ -191,6 +230,12 @@ sys_open(void)
       eput(ep);
       return -1;
     }
+    // a program some process runs can't be changed
+    if(ep->ntext > 0 && (omode & (O_WRONLY|O_RDWR|O_TRUNC))){
+      eunlock(ep);
+      eput(ep);
+      return -1;
+    }
   }
 
   if((f = filealloc()) == NULL || (fd = fdalloc(f)) < 0){
@@ -252,17 +297,16 @@ sys_chdir(void)
   return 0;
 }
 
-uint64
-sys_pipe(void)
+// Make a pipe with a ring of at least size bytes and store
+// its read and write fds at user address fdarray.
+static int
+pipefds(uint64 fdarray, int size)
 {
-  uint64 fdarray; // user pointer to array of two integers
   struct file *rf, *wf;
   int fd0, fd1;
   struct proc *p = myproc();
 
-  if(argaddr(0, &fdarray) < 0)
-    return -1;
-  if(pipealloc(&rf, &wf) < 0)
+  if(pipealloc(&rf, &wf, size) < 0)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
@@ -283,6 +327,29 @@ sys_pipe(void)
   return 0;
 }
 
+uint64
+sys_pipe(void)
+{
+  uint64 fdarray; // user pointer to array of two integers
+
+  if(argaddr(0, &fdarray) < 0)
+    return -1;
+  return pipefds(fdarray, 0);
+}
+
+// pipe2(fds, size): a pipe whose ring holds at least size
+// bytes, up to 2^PIPEMAXORDER pages.
+uint64
+sys_pipe2(void)
+{
+  uint64 fdarray;
+  int size;
+
+  if(argaddr(0, &fdarray) < 0 || argint(1, &size) < 0)
+    return -1;
+  return pipefds(fdarray, size);
+}
+
 // To open console device.
 uint64
 sys_dev(void)
@@ -340,6 +407,19 @@ sys_readdir(void)
   return dirnext(f, p);
 }
 
+// Read many directory entries at once, see dirents().
+uint64
+sys_getdents(void)
+{
+  struct file *f;
+  uint64 p;
+  int n;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0)
+    return -1;
+  return dirents(f, p, n);
+}
+
 // get absolute cwd string
 uint64
 sys_getcwd(void)
@@ -483,7 +563,7 @@ sys_rename(void)
   struct dirent *psrc = src->parent;  // src must not be root, or it won't pass the for-loop test
   src->parent = edup(pdst);
   src->off = off;
-  src->valid = 1;
+  evalid(src);
   eunlock(src);
 
   eput(psrc);
@@ -511,6 +591,6 @@ fail:
 uint64
 sys_flushdisk(void)
 {
-  disk_flush();
-  return 0;
+  bflush();
+  return disk_flush();
 }
\ No newline at end of file
@@ -15,6 +15,8 @@
 #include "include/disk.h"
 #include "include/exception.h"
 #include "include/swap.h"
+#include "include/vm.h"
+#include "include/buf.h"
 
 
 
@@ -93,6 +95,15 @@ usertrap(void)
     syscall();
   } 
 
+  else if(r_scause() == EXC_STORE_PAGE_FAULT && uvmcow(p->pagetable, r_stval()) == 0){
+    // store to a copy-on-write page, which now is private
+  }
+
+  else if((r_scause() == EXC_INSTR_PAGE_FAULT || r_scause() == EXC_LOAD_PAGE_FAULT
+           || r_scause() == EXC_STORE_PAGE_FAULT) && lazyalloc(r_stval()) == 0){
+    // first touch of a demand-paged program page or heap page
+  }
+
   else if((which_dev = devintr()) != 0){
     // ok, was just a device craving some attention
   } 
@@ -129,8 +140,10 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if this is a timer interrupt,
+  // after writing back blocks that have been dirty too long.
   if(which_dev == 2){
+    bflush_tick();
     yield();
   }
 
@@ -92,11 +92,9 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == NULL)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == NULL)
         return NULL;
 
-      memset_d(pagetable, 0, PGSIZE/8);
-
       *pte = PA2PTE(pagetable) | PTE_V;
 
       #ifdef DEBUG
@@ -234,16 +232,34 @@ vmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
   }
 }
 
+// Like vmunmap(), for user memory: pages that were never
+// faulted in (demand-paged program pages, lazy heap) are
+// skipped.
+void
+uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
+{
+  uint64 a;
+  pte_t *pte;
+
+  if((va % PGSIZE) != 0)
+    panic("uvmunmap: not aligned");
+
+  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      continue;
+    vmunmap(pagetable, a, 1, do_free);
+  }
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == NULL)
     return NULL;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -258,12 +274,11 @@ uvminit(pagetable_t pagetable, pagetable_t kpagetable, uchar *src, uint sz)
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
 
-  mem = kalloc();
+  mem = kzalloc();
   #ifdef DEBUG
     printf("[uvminit]kalloc: %p\n", mem);
   #endif
   
-  memset_d(mem, 0, PGSIZE/8);
   if(mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U) == -1){
     panic("inituvm map pt");
   };
@@ -289,12 +304,11 @@ uvmalloc(pagetable_t pagetable, pagetable_t kpagetable, uint64 oldsz, uint64 new
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == NULL){
       uvmdealloc(pagetable, kpagetable, a, oldsz);
       return 0;
     }
-    memset_d(mem, 0, PGSIZE/8);
     if (mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0) {
       kfree(mem);
       uvmdealloc(pagetable, kpagetable, a, oldsz);
@@ -317,7 +331,7 @@ uvmdealloc(pagetable_t pagetable, pagetable_t kpagetable, uint64 oldsz, uint64 n
 
   if(PGROUNDUP(newsz) < PGROUNDUP(oldsz)){
     int npages = (PGROUNDUP(oldsz) - PGROUNDUP(newsz)) / PGSIZE;
-    vmunmap(pagetable, PGROUNDUP(newsz), npages, 1);
+    uvmunmap(pagetable, PGROUNDUP(newsz), npages, 1);
   }
 
   return newsz;
@@ -350,48 +364,83 @@ void
 uvmfree(pagetable_t pagetable, uint64 sz)
 {
   if(sz > 0)
-    vmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1);
+    uvmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1);
   freewalk(pagetable);
 }
 
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table.
+// Writable pages are mapped copy-on-write in
+// both page tables; uvmcow() copies them on
+// the first store. The caller must flush the
+// parent's TLB entries afterwards.
 // returns 0 on success, -1 on failure.
-// frees any allocated pages on failure.
+// drops any taken references on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, pagetable_t knew, uint64 sz)
 {
   pte_t *pte;
   uint64 pa, i = 0;
   uint flags;
-  char *mem;
 
   while (i < sz){
-    if((pte = walk(old, i, 0)) == NULL)
-      panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
+    if((pte = walk(old, i, 0)) == NULL || (*pte & PTE_V) == 0){
+      // never faulted in, the child will fault it in itself
+      i += PGSIZE;
+      continue;
+    }
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == NULL)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0) {
-      kfree(mem);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0)
       goto err;
-    }
+    kdup((void*)pa);
     i += PGSIZE;
   }
   return 0;
 
  err:
-  vmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, 0, i / PGSIZE, 1);
   return -1;
 }
 
+// Resolve a store to the copy-on-write page at va.
+// A page that is still shared is replaced by a private
+// copy; the last owner just gets write access back.
+// Returns 0 on success, -1 if va is not a user COW page
+// or there is no memory left for the copy.
+int
+uvmcow(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  if((pte = walk(pagetable, PGROUNDDOWN(va), 0)) == NULL)
+    return -1;
+  if((*pte & (PTE_V | PTE_U | PTE_COW)) != (PTE_V | PTE_U | PTE_COW))
+    return -1;
+
+  pa = PTE2PA(*pte);
+  if(krefcnt((void*)pa) > 1){
+    if((mem = kalloc()) == NULL)
+      return -1;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+    kfree((void*)pa);
+  } else {
+    *pte = (*pte & ~PTE_COW) | PTE_W;
+  }
+
+  // the old read-only translation may still be cached
+  sfence_vma();
+  return 0;
+}
+
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
 void
@@ -406,6 +455,20 @@ uvmclear(pagetable_t pagetable, uint64 va)
   
 }
 
+// Like walkaddr(), but when looking up the current
+// process's memory, fault in pages that were not touched
+// yet, as the hardware would for a user access.
+static uint64
+uwalkaddr(pagetable_t pagetable, uint64 va)
+{
+  uint64 pa = walkaddr(pagetable, va);
+
+  struct proc *p = myproc();
+  if(pa == NULL && p != NULL && p->pagetable == pagetable && lazyalloc(va) == 0)
+    pa = walkaddr(pagetable, va);
+  return pa;
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -413,12 +476,23 @@ int
 copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
+  pte_t *pte;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uwalkaddr(pagetable, va0);
     if(pa0 == NULL)
       return -1;
+    // break copy-on-write sharing before the kernel writes;
+    // read-only pages, shared program text among them, stay so
+    pte = walk(pagetable, va0, 0);
+    if((*pte & (PTE_W | PTE_COW)) == 0)
+      return -1;
+    if(*pte & PTE_COW){
+      if(uvmcow(pagetable, va0) < 0)
+        return -1;
+      pa0 = PTE2PA(*pte);
+    }
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
@@ -442,7 +516,7 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uwalkaddr(pagetable, va0);
     if(pa0 == NULL)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -470,7 +544,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uwalkaddr(pagetable, va0);
     if(pa0 == NULL)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -283,14 +283,14 @@ flags);
 static void
 putc(int fd, char c)
 {
-  write(fd, &c, 1);
+  bputc(fd, c);
 }
 
 
 static void
 puts(int fd, char* s)
 {
-  write(fd, s, strlen(s));
+  bwrite(fd, s, strlen(s));
 }
 
 
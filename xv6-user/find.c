@@ -7,8 +7,10 @@ static char path[512];
 
 void find(char *filename)
 {
-    int fd;
+    int fd, n;
     struct stat st;
+    struct dent *d;
+    uint64 buf[48];     // holds a record of the longest name
     if ((fd = open(path, O_RDONLY)) < 0) {
         fprintf(2, "find: cannot open %s\n", path);
         return;
@@ -32,15 +34,19 @@ void find(char *filename)
         *++p = '/';
     }
     p++;
-    while (readdir(fd, &st)) {
-        strcpy(p, st.name);
-        if (strcmp(p, ".") == 0 || strcmp(p, "..") == 0) {
-            continue;
+    while ((n = getdents(fd, (struct dent *)buf, sizeof(buf))) > 0) {
+        for (d = (struct dent *)buf; (char *)d < (char *)buf + n; d = (struct dent *)((char *)d + d->reclen)) {
+            strcpy(p, d->name);
+            if (strcmp(p, ".") == 0 || strcmp(p, "..") == 0) {
+                continue;
+            }
+            if (strcmp(p, filename) == 0) {
+                fprintf(1, "%s\n", path);
+            }
+            if (d->type == T_DIR) {
+                find(filename);
+            }
         }
-        if (strcmp(p, filename) == 0) {
-            fprintf(1, "%s\n", path);
-        }
-        find(filename);
     }
     close(fd);
     return;
@@ -4,8 +4,11 @@
 
 int main()
 {
-    if (flush_disk() < 0) {
+    int n = flush_disk();
+    if (n < 0) {
         printf("flush fail!\n");
+    } else {
+        printf("flushed %d KB\n", n / 1024);
     }
     exit(0);
 }
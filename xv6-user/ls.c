@@ -20,8 +20,10 @@ fmtname(char *name)
 void
 ls(char *path)
 {
-  int fd;
+  int fd, n;
   struct stat st;
+  struct dent *d;
+  uint64 buf[64];
   char *types[] = {
     [T_DIR]   "DIR ",
     [T_FILE]  "FILE",
@@ -39,8 +41,9 @@ ls(char *path)
   }
 
   if (st.type == T_DIR){
-    while(readdir(fd, &st) == 1){
-      printf("%s %s\t%d\n", fmtname(st.name), types[st.type], st.size);
+    while((n = getdents(fd, (struct dent *)buf, sizeof(buf))) > 0){
+      for(d = (struct dent *)buf; (char *)d < (char *)buf + n; d = (struct dent *)((char *)d + d->reclen))
+        printf("%s %s\t%d\n", fmtname(d->name), types[d->type], d->size);
     }
   } else {
     printf("%s %s\t%l\n", fmtname(st.name), types[st.type], st.size);
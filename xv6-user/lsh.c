@@ -20,8 +20,10 @@ fmtname(char *name)
 void
 ls(char *path)
 {
-  int fd;
+  int fd, n;
   struct stat st;
+  struct dent *d;
+  uint64 buf[64];
   char *types[] = {
     [T_DIR]   "DIR ",
     [T_FILE]  "FILE",
@@ -41,14 +43,16 @@ ls(char *path)
   }
 
   if (st.type == T_DIR){
-    while(readdir(fd, &st) == 1){
-      printf("%s %s\t", fmtname(st.name), types[st.type]);
-      uint64 dsize = st.size;
-      int lvl;
-      for(lvl = 0; dsize > 1024 && lvl < 4; lvl++){
-        dsize = dsize >> 10;
+    while((n = getdents(fd, (struct dent *)buf, sizeof(buf))) > 0){
+      for(d = (struct dent *)buf; (char *)d < (char *)buf + n; d = (struct dent *)((char *)d + d->reclen)){
+        printf("%s %s\t", fmtname(d->name), types[d->type]);
+        uint64 dsize = d->size;
+        int lvl;
+        for(lvl = 0; dsize > 1024 && lvl < 4; lvl++){
+          dsize = dsize >> 10;
+        }
+        printf("%l %s\n", dsize, sizes[lvl]);
       }
-      printf("%l %s\n", dsize, sizes[lvl]);
     }
   } else {
     printf("%s %s\t", fmtname(st.name), types[st.type]);
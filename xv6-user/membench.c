@@ -0,0 +1,77 @@
+// Bytes per cycle of the ulib memory and string routines
+// for 16 B, 512 B and 4 KB buffers.
+
+#include "kernel/include/types.h"
+#include "xv6-user/user.h"
+
+#define BUFSZ 4096
+
+char a[BUFSZ + 8], b[BUFSZ + 8];
+int sink;
+
+static uint64
+cycles(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x));
+  return x;
+}
+
+// prints bytes per cycle with two decimals
+static void
+report(char *name, int n, int iters, uint64 c)
+{
+  uint64 bpc = (uint64)n * iters * 100 / (c ? c : 1);
+
+  printf("%s\t%d\t%d.%d%d\n", name, n, (int)(bpc / 100), (int)(bpc / 10 % 10), (int)(bpc % 10));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int sizes[] = { 16, 512, BUFSZ };
+  int i, k, n, iters;
+  uint64 start;
+
+  memset(a, 'x', BUFSZ);
+  printf("OP\tBYTES\tBYTES/CYCLE\n");
+  for(k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++){
+    n = sizes[k];
+    iters = (256 * 1024) / n;
+
+    start = cycles();
+    for(i = 0; i < iters; i++)
+      memset(b, i, n);
+    report("memset", n, iters, cycles() - start);
+
+    start = cycles();
+    for(i = 0; i < iters; i++)
+      memmove(b, a, n);
+    report("memmove", n, iters, cycles() - start);
+
+    start = cycles();
+    for(i = 0; i < iters; i++)
+      sink += memcmp(a, b, n);
+    report("memcmp", n, iters, cycles() - start);
+
+    a[n - 1] = 0;
+    memmove(b, a, n);
+    start = cycles();
+    for(i = 0; i < iters; i++)
+      sink += strlen(a);
+    report("strlen", n, iters, cycles() - start);
+
+    start = cycles();
+    for(i = 0; i < iters; i++)
+      sink += strcmp(a, b);
+    report("strcmp", n, iters, cycles() - start);
+    a[n - 1] = 'x';
+  }
+
+  // unaligned pairs take the byte path
+  start = cycles();
+  for(i = 0; i < 64; i++)
+    memmove(b + 1, a, BUFSZ);
+  report("memmove+1", BUFSZ, 64, cycles() - start);
+  exit(0);
+}
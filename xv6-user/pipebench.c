@@ -0,0 +1,85 @@
+// Time "cat file | wc" through a pipe with a given ring size.
+//
+// usage: pipebench [kbytes [ringbytes]]
+// Writes a kbytes large test file (default 256), then runs cat
+// and wc on it connected by pipe2(fds, ringbytes) and prints
+// the cycles taken and the throughput.
+
+#include "kernel/include/types.h"
+#include "kernel/include/fcntl.h"
+#include "xv6-user/user.h"
+
+#define FILENAME "pipebench.dat"
+
+char buf[4096];
+
+static uint64
+cycles(void)
+{
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r" (x));
+  return x;
+}
+
+static void
+mkfile(int kb)
+{
+  int fd, i;
+
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+  if((fd = open(FILENAME, O_CREATE | O_WRONLY)) < 0){
+    fprintf(2, "pipebench: cannot create %s\n", FILENAME);
+    exit(1);
+  }
+  for(i = 0; i < kb; i += 4)
+    write(fd, buf, kb - i < 4 ? (kb - i) * 1024 : sizeof(buf));
+  close(fd);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int kb = 256, ring = 0, fds[2];
+  char *catargv[] = { "cat", FILENAME, 0 };
+  char *wcargv[] = { "wc", 0 };
+  uint64 start, c;
+
+  if(argc > 1)
+    kb = atoi(argv[1]);
+  if(argc > 2)
+    ring = atoi(argv[2]);
+  mkfile(kb);
+  if(pipe2(fds, ring) < 0){
+    fprintf(2, "pipebench: pipe2(%d) failed\n", ring);
+    exit(1);
+  }
+
+  start = cycles();
+  if(fork() == 0){
+    close(1);
+    dup(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+    exec("cat", catargv);
+    exit(1);
+  }
+  if(fork() == 0){
+    close(0);
+    dup(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    exec("wc", wcargv);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  wait(0);
+  wait(0);
+  c = cycles() - start;
+
+  printf("%d KB, ring %d: %l cycles, %l bytes/kcycle\n",
+         kb, ring, c, (uint64)kb * 1024 * 1000 / (c ? c : 1));
+  remove(FILENAME);
+  exit(0);
+}
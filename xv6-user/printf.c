@@ -9,7 +9,7 @@ static char digits[] = "0123456789ABCDEF";
 static void
 putc(int fd, char c)
 {
-  write(fd, &c, 1);
+  bputc(fd, c);
 }
 
 static void
@@ -0,0 +1,123 @@
+// Buffered output for printf() and fprintf().
+//
+// Each fd gets a buffer the first time it is written: fully
+// buffered for files and pipes, unbuffered for fd 2, line
+// buffered for everything else (the console, devices). Buffers are written out when full, by fflush(),
+// and by the exit(), fork(), exec(), close() and gets() wrappers
+// in ulib.c.
+// Call fflush() before mixing write() with printf on one fd.
+
+#include "kernel/include/types.h"
+#include "kernel/include/stat.h"
+#include "xv6-user/user.h"
+
+#define NSTDIO   16   // fds with an output buffer
+#define OBUFSZ  512
+
+enum { OB_UNSET, OB_NONE, OB_LINE, OB_FULL };
+
+struct obuf {
+  int mode;
+  int n;
+  char buf[OBUFSZ];
+};
+
+static struct obuf obufs[NSTDIO];
+
+extern void (*stdio_flush)(void);
+extern void (*stdio_close)(int);
+
+static void
+flushall(void)
+{
+  for(int fd = 0; fd < NSTDIO; fd++)
+    fflush(fd);
+}
+
+static void
+closefd(int fd)
+{
+  if(fd < 0 || fd >= NSTDIO)
+    return;
+  fflush(fd);
+  obufs[fd].mode = OB_UNSET;
+}
+
+void
+fflush(int fd)
+{
+  struct obuf *b;
+
+  if(fd < 0 || fd >= NSTDIO)
+    return;
+  b = &obufs[fd];
+  if(b->n > 0)
+    write(fd, b->buf, b->n);
+  b->n = 0;
+}
+
+static struct obuf *
+obuf(int fd)
+{
+  struct obuf *b;
+  struct stat st;
+
+  if(fd < 0 || fd >= NSTDIO)
+    return 0;
+  b = &obufs[fd];
+  if(b->mode == OB_UNSET){
+    if(fd == 2)
+      b->mode = OB_NONE;
+    else if(fstat(fd, &st) == 0 && (st.type == T_FILE || st.type == T_PIPE))
+      b->mode = OB_FULL;
+    else
+      b->mode = OB_LINE;
+    stdio_flush = flushall;
+    stdio_close = closefd;
+  }
+  return b->mode == OB_NONE ? 0 : b;
+}
+
+// Queue n bytes of s for fd.
+void
+bwrite(int fd, const char *s, int n)
+{
+  struct obuf *b;
+  int m, nl = 0;
+
+  if((b = obuf(fd)) == 0){
+    write(fd, s, n);
+    return;
+  }
+  while(n > 0){
+    if(b->n == OBUFSZ)
+      fflush(fd);
+    m = OBUFSZ - b->n;
+    if(m > n)
+      m = n;
+    for(int i = 0; i < m; i++)
+      if((b->buf[b->n + i] = s[i]) == '\n')
+        nl = 1;
+    b->n += m;
+    s += m;
+    n -= m;
+  }
+  if(b->mode == OB_LINE && nl)
+    fflush(fd);
+}
+
+void
+bputc(int fd, char c)
+{
+  struct obuf *b;
+
+  if((b = obuf(fd)) == 0){
+    write(fd, &c, 1);
+    return;
+  }
+  if(b->n == OBUFSZ)
+    fflush(fd);
+  b->buf[b->n++] = c;
+  if(b->mode == OB_LINE && c == '\n')
+    fflush(fd);
+}
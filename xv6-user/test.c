@@ -11,6 +11,10 @@ int main()
     } else {
         printf("memory left: %d KB\n", info.freemem >> 10);
         printf("process amount: %d\n", info.nproc);
+        printf("free blocks:");
+        for (int i = 0; i < NORDER; i++)
+            printf(" %d", info.nfree[i]);
+        printf("\n");
     }
     exit(0);
 }
@@ -19,6 +19,7 @@ main(void)
 
   printf("sent something");
   fprintf(uart_fd, "Hello from AUX!");
+  fflush(uart_fd);
   write(uart_fd, teststr, sizeof(teststr));
   exit(0);
 }
@@ -3,6 +3,20 @@
 #include "kernel/include/fcntl.h"
 #include "xv6-user/user.h"
 
+// The memory and string routines below work a 64-bit word at
+// a time once the pointers are 8-byte aligned. Programs are
+// built with -mstrict-align, so two pointers only take the word
+// path when they share the same offset mod 8; other pairs
+// fall back to bytes. Aligned word reads never cross a page,
+// so reading the whole word that holds a terminating NUL is safe.
+
+#define WALIGNED(p)     (((uint64)(p) & 7) == 0)
+#define COALIGNED(p, q) ((((uint64)(p) ^ (uint64)(q)) & 7) == 0)
+#define ONES            0x0101010101010101UL
+#define HIGHS           0x8080808080808080UL
+// nonzero if one of the bytes of w is zero
+#define HASZERO(w)      (((w) - ONES) & ~(w) & HIGHS)
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -29,6 +43,16 @@ strcat(char *s, const char *t)
 int
 strcmp(const char *p, const char *q)
 {
+  if(COALIGNED(p, q)){
+    while(!WALIGNED(p)){
+      if(*p == 0 || *p != *q)
+        return (uchar)*p - (uchar)*q;
+      p++, q++;
+    }
+    // skip equal words without a NUL, the bytes below finish
+    while(*(const uint64 *)p == *(const uint64 *)q && !HASZERO(*(const uint64 *)p))
+      p += 8, q += 8;
+  }
   while(*p && *p == *q)
     p++, q++;
   return (uchar)*p - (uchar)*q;
@@ -54,11 +78,17 @@ strncmp(const char *s1, const char *s2, uint64 n)
 uint
 strlen(const char *s)
 {
-  int n;
+  const char *p = s;
+  const uint64 *w;
 
-  for(n = 0; s[n]; n++)
+  for(; !WALIGNED(p); p++)
+    if(*p == 0)
+      return p - s;
+  for(w = (const uint64 *) p; !HASZERO(*w); w++)
     ;
-  return n;
+  for(p = (const char *) w; *p; p++)
+    ;
+  return p - s;
 }
 
 uint
@@ -76,11 +106,26 @@ strnlen(const char *s, uint maxlen)
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uchar *d = (uchar *) dst;
+  uint64 w, *wd;
+
+  while(n > 0 && !WALIGNED(d)){
+    *d++ = c;
+    n--;
+  }
+  if(n >= 8){
+    w = (uchar)c * ONES;
+    wd = (uint64 *) d;
+    for(; n >= 64; n -= 64, wd += 8){
+      wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+      wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
+    }
+    for(; n >= 8; n -= 8)
+      *wd++ = w;
+    d = (uchar *) wd;
   }
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -93,16 +138,38 @@ strchr(const char *s, char c)
   return 0;
 }
 
+// Set by stdio.c once some fd has buffered output.
+void (*stdio_flush)(void);
+void (*stdio_close)(int);
+
+// Input gets() has read ahead. Only the console is read in
+// chunks, it returns at most a line anyway. From a file or pipe
+// the rest belongs to whoever reads fd 0 next, a command the
+// shell runs for one, so those are read a byte at a time.
+static char inbuf[512];
+static int inpos, inlen;
+
 char*
 gets(char *buf, int max)
 {
-  int i, cc;
+  int i, cc, chunk = -1;
+  struct stat st;
   char c;
 
+  // a prompt printed before must show up first
+  if(stdio_flush)
+    stdio_flush();
   for(i=0; i+1 < max; ){
-    cc = read(0, &c, 1);
-    if(cc < 1)
-      break;
+    if(inpos == inlen){
+      if(chunk < 0)
+        chunk = fstat(0, &st) == 0 && st.type == T_DEVICE ? sizeof(inbuf) : 1;
+      cc = read(0, inbuf, chunk);
+      if(cc < 1)
+        break;
+      inpos = 0;
+      inlen = cc;
+    }
+    c = inbuf[inpos++];
     buf[i++] = c;
     if(c == '\n' || c == '\r')
       break;
@@ -111,6 +178,43 @@ gets(char *buf, int max)
   return buf;
 }
 
+// fork() and exit() write out buffered output first, so it
+// is neither printed twice nor lost.
+int
+fork(void)
+{
+  if(stdio_flush)
+    stdio_flush();
+  return _fork();
+}
+
+int
+exit(int status)
+{
+  if(stdio_flush)
+    stdio_flush();
+  _exit(status);
+}
+
+// close() writes out the fd's buffer and forgets how it was
+// buffered, the fd number may next be a different file.
+int
+close(int fd)
+{
+  if(stdio_close)
+    stdio_close(fd);
+  return _close(fd);
+}
+
+// exec() replaces the buffers along with the program.
+int
+exec(char *path, char **argv)
+{
+  if(stdio_flush)
+    stdio_flush();
+  return _exec(path, argv);
+}
+
 int
 stat(const char *n, struct stat *st)
 {
@@ -145,15 +249,50 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  uint64 *wd;
+  const uint64 *ws;
 
   dst = vdst;
   src = vsrc;
   if (src > dst) {
+    if (COALIGNED(src, dst)) {
+      while (n > 0 && !WALIGNED(dst)) {
+        *dst++ = *src++;
+        n--;
+      }
+      wd = (uint64 *) dst;
+      ws = (const uint64 *) src;
+      for (; n >= 64; n -= 64, wd += 8, ws += 8) {
+        wd[0] = ws[0]; wd[1] = ws[1]; wd[2] = ws[2]; wd[3] = ws[3];
+        wd[4] = ws[4]; wd[5] = ws[5]; wd[6] = ws[6]; wd[7] = ws[7];
+      }
+      for (; n >= 8; n -= 8)
+        *wd++ = *ws++;
+      dst = (char *) wd;
+      src = (const char *) ws;
+    }
     while(n-- > 0)
       *dst++ = *src++;
   } else {
     dst += n;
     src += n;
+    if (COALIGNED(src, dst)) {
+      while (n > 0 && !WALIGNED(dst)) {
+        *--dst = *--src;
+        n--;
+      }
+      wd = (uint64 *) dst;
+      ws = (const uint64 *) src;
+      for (; n >= 64; n -= 64) {
+        wd -= 8, ws -= 8;
+        wd[7] = ws[7]; wd[6] = ws[6]; wd[5] = ws[5]; wd[4] = ws[4];
+        wd[3] = ws[3]; wd[2] = ws[2]; wd[1] = ws[1]; wd[0] = ws[0];
+      }
+      for (; n >= 8; n -= 8)
+        *--wd = *--ws;
+      dst = (char *) wd;
+      src = (const char *) ws;
+    }
     while(n-- > 0)
       *--dst = *--src;
   }
@@ -163,7 +302,19 @@ memmove(void *vdst, const void *vsrc, int n)
 int
 memcmp(const void *s1, const void *s2, uint n)
 {
-  const char *p1 = s1, *p2 = s2;
+  const uchar *p1 = s1, *p2 = s2;
+
+  if (COALIGNED(p1, p2)) {
+    while (n > 0 && !WALIGNED(p1)) {
+      if (*p1 != *p2)
+        return *p1 - *p2;
+      p1++, p2++, n--;
+    }
+    // skip equal words, the bytes below find the difference
+    for (; n >= 8; n -= 8, p1 += 8, p2 += 8)
+      if (*(const uint64 *)p1 != *(const uint64 *)p2)
+        break;
+  }
   while (n-- > 0) {
     if (*p1 != *p2) {
       return *p1 - *p2;
@@ -5,6 +5,7 @@
 struct stat;
 struct rtcdate;
 struct sysinfo;
+struct dent;
 
 // system calls
 int fork(void);
@@ -40,6 +41,12 @@ uint64 frame(void);
 uint64 pmu_setup(uint64 config_mask, uint64* event_codes, uint64* flags);
 uint64 pmu_control(int action, uint64 handle_mask, uint64* values_out);
 
+int pipe2(int*, int size);
+int getdents(int fd, struct dent*, int n);
+long lseek(int fd, long off, int whence);
+int pread(int fd, void *buf, int n, uint64 off);
+int pwrite(int fd, const void *buf, int n, uint64 off);
+
 // ulib.c
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
@@ -57,3 +64,12 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _close(int);
+int _exec(char*, char**);
+
+// stdio.c
+void fflush(int fd);
+void bwrite(int fd, const char *s, int n);
+void bputc(int fd, char c);
@@ -1,6 +1,7 @@
 #include "kernel/include/param.h"
 #include "kernel/include/types.h"
 #include "kernel/include/stat.h"
+#include "kernel/include/sysinfo.h"
 #include "xv6-user/user.h"
 #include "kernel/include/fcntl.h"
 #include "kernel/include/syscall.h"
@@ -626,6 +627,146 @@ void dirtest(char *s)
   printf("%s: mkdir test ok\n");
 }
 
+// printf output to a file is buffered; exit() must write it
+// out, and fork() must not let the child print it again.
+void
+stdiobuf(char *s)
+{
+  char buf[32];
+  int fd, pid, xstatus, n;
+
+  remove("stdiobuf");
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    fd = open("stdiobuf", O_CREATE|O_WRONLY);
+    if(fd < 0)
+      exit(1);
+    fprintf(fd, "a%d", 1);
+    if(fork() == 0){
+      fprintf(fd, "b");
+      exit(0);
+    }
+    wait(0);
+    fprintf(fd, "c");
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child failed\n", s);
+    exit(1);
+  }
+  fd = open("stdiobuf", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  remove("stdiobuf");
+  buf[n < 0 ? 0 : n] = 0;
+  if(strcmp(buf, "a1bc") != 0){
+    printf("%s: file has \"%s\", not \"a1bc\"\n", s, buf);
+    exit(1);
+  }
+}
+
+// a program run a second time maps its image from the kernel's
+// program page cache: it must read none of it from the file.
+void
+textcache(char *s)
+{
+  char *echoargv[] = { "echo", "x", 0 };
+  struct sysinfo before, after;
+  int i, pid, xstatus;
+
+  for(i = 0; i < 2; i++){
+    if(sysinfo(&before) < 0){
+      printf("%s: sysinfo failed\n", s);
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(1);
+      exec("echo", echoargv);
+      exit(1);
+    }
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: echo failed\n", s);
+      exit(1);
+    }
+  }
+  sysinfo(&after);
+  if(after.pcmisses != before.pcmisses){
+    printf("%s: second run read %d pages from the file\n", s,
+           after.pcmisses - before.pcmisses);
+    exit(1);
+  }
+  if(after.pchits == before.pchits){
+    printf("%s: second run found nothing cached\n", s);
+    exit(1);
+  }
+}
+
+// a program that some process is running pages its image in
+// from the file, so the file can't be opened for writing.
+void
+textbusy(char *s)
+{
+  char *catargv[] = { "cat", 0 };
+  int fds[2], fd, i, pid, xstatus;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    // cat waits on the pipe until the parent closes it
+    close(0);
+    dup(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    exec("cat", catargv);
+    exit(1);
+  }
+  close(fds[0]);
+  // the child may not have got to exec() yet
+  for(i = 0; i < 100; i++){
+    if((fd = open("cat", O_WRONLY)) < 0)
+      break;
+    close(fd);
+    sleep(1);
+  }
+  close(fds[1]);
+  wait(&xstatus);
+  if(i == 100){
+    printf("%s: running program opened for writing\n", s);
+    exit(1);
+  }
+  if(xstatus != 0){
+    printf("%s: cat failed\n", s);
+    exit(1);
+  }
+  if((fd = open("cat", O_WRONLY)) < 0){
+    printf("%s: program still busy after exit\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
 void
 exectest(char *s)
 {
@@ -971,6 +1112,719 @@ reparent2(char *s)
   exit(0);
 }
 
+// fork a process that holds more than half of free memory.
+// only works if fork shares pages copy-on-write; also checks
+// that stores in parent and child stay private to each.
+void
+cowfork(char *s)
+{
+  struct sysinfo info;
+  char *a, *p;
+  uint64 sz;
+  int pid, xstatus;
+
+  if(sysinfo(&info) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  sz = (info.freemem / 3) * 2;
+  a = sbrk(sz);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk(%d) failed\n", s, sz);
+    exit(1);
+  }
+  for(p = a; p < a + sz; p += PGSIZE)
+    *(int*)p = getpid();
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    int ppid = *(int*)a;
+    for(p = a; p < a + sz; p += 16 * PGSIZE){
+      if(*(int*)p != ppid)
+        exit(1);
+      *(int*)p = getpid();
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child saw wrong data\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + sz; p += PGSIZE){
+    if(*(int*)p != getpid()){
+      printf("%s: child store leaked into parent\n", s);
+      exit(1);
+    }
+  }
+  sbrk(-sz);
+}
+
+// stream data through pipes of several ring sizes in odd-sized
+// writes and reads, checking every byte arrives in order.
+void
+pipebig(char *s)
+{
+  static int sizes[] = { 0, 3 * 4096, 16 * 4096 };
+  static char buf[1500];
+  int fds[2], pid, xstatus, i, n, total, k;
+
+  for(k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++){
+    if(pipe2(fds, sizes[k]) != 0){
+      printf("%s: pipe2(%d) failed\n", s, sizes[k]);
+      exit(1);
+    }
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(fds[0]);
+      for(total = 0; total < 100000; total += n){
+        n = 100000 - total < 1499 ? 100000 - total : 1499;
+        for(i = 0; i < n; i++)
+          buf[i] = (total + i) % 251;
+        if(write(fds[1], buf, n) != n)
+          exit(1);
+      }
+      exit(0);
+    }
+    close(fds[1]);
+    total = 0;
+    while((n = read(fds[0], buf, 1001)) > 0){
+      for(i = 0; i < n; i++){
+        if(buf[i] != (char)((total + i) % 251)){
+          printf("%s: wrong byte at %d\n", s, total + i);
+          exit(1);
+        }
+      }
+      total += n;
+    }
+    close(fds[0]);
+    wait(&xstatus);
+    if(total != 100000 || xstatus != 0){
+      printf("%s: read %d bytes, writer status %d\n", s, total, xstatus);
+      exit(1);
+    }
+  }
+  if(pipe2(fds, 1024 * 1024) == 0){
+    printf("%s: pipe2 with a 1 MB ring succeeded\n", s);
+    exit(1);
+  }
+}
+
+// struct pipes come from a slab cache, so beside its ring page
+// each pipe must not take a page of its own.
+void
+pipemany(char *s)
+{
+  struct sysinfo info;
+  uint64 before;
+  int fds[6][2], i;
+
+  if(sysinfo(&info) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  before = info.freemem;
+  for(i = 0; i < 6; i++){
+    if(pipe(fds[i]) != 0){
+      printf("%s: pipe() failed\n", s);
+      exit(1);
+    }
+  }
+  sysinfo(&info);
+  if(before - info.freemem > (6 + 2) * PGSIZE){
+    printf("%s: 6 pipes took %d bytes\n", s, before - info.freemem);
+    exit(1);
+  }
+  for(i = 0; i < 6; i++){
+    if(write(fds[i][1], "x", 1) != 1){
+      printf("%s: pipe write failed\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < 6; i++){
+    char c = 0;
+    if(read(fds[i][0], &c, 1) != 1 || c != 'x'){
+      printf("%s: pipe read failed\n", s);
+      exit(1);
+    }
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+}
+
+// reading a file back in pieces smaller than a block must be
+// served from the buffer cache, and the cache counters must
+// show it. (whole blocks may bypass the cache.)
+void
+bcachestat(char *s)
+{
+  struct sysinfo before, after;
+  char buf[512];
+  int fd, i;
+
+  fd = open("bcachestat", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  memset(buf, 'b', sizeof(buf));
+  for(i = 0; i < 4; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  if(sysinfo(&before) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  fd = open("bcachestat", O_RDONLY);
+  while(read(fd, buf, sizeof(buf) / 2) > 0)
+    ;
+  close(fd);
+  sysinfo(&after);
+  remove("bcachestat");
+
+  if(after.nbuf < 30){
+    printf("%s: only %d bufs\n", s, after.nbuf);
+    exit(1);
+  }
+  if(after.bhits < before.bhits + 4){
+    printf("%s: %d buffer cache hits for 4 cached blocks\n", s, after.bhits - before.bhits);
+    exit(1);
+  }
+}
+
+// many small writes to one block must be coalesced by the
+// write-back buffer cache, not each go to the disk.
+void
+writeback(char *s)
+{
+  struct sysinfo before, after;
+  char buf[512];
+  int fd, i;
+
+  fd = open("writeback", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  sysinfo(&before);
+  for(i = 0; i < sizeof(buf); i++){
+    if(write(fd, "w", 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  sysinfo(&after);
+  close(fd);
+
+  if(after.bwritebacks - before.bwritebacks > sizeof(buf) / 8){
+    printf("%s: %d writebacks for %d writes\n", s,
+           after.bwritebacks - before.bwritebacks, sizeof(buf));
+    exit(1);
+  }
+
+  fd = open("writeback", O_RDONLY);
+  if(fd < 0 || read(fd, buf, sizeof(buf)) != sizeof(buf)){
+    printf("%s: read back failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  remove("writeback");
+  for(i = 0; i < sizeof(buf); i++){
+    if(buf[i] != 'w'){
+      printf("%s: wrong byte at %d\n", s, i);
+      exit(1);
+    }
+  }
+}
+
+// a file read from start to end must read back right, with
+// readahead asking for each part of it at most once.
+void
+readahead(char *s)
+{
+  enum { N = 64 };
+  struct sysinfo before, after;
+  char buf[512];
+  int fd, i, j;
+
+  fd = open("readahead", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    memset(buf, 'a' + i % 26, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  sysinfo(&before);
+  fd = open("readahead", O_RDONLY);
+  for(i = 0; i < N; i++){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: read %d failed\n", s, i);
+      exit(1);
+    }
+    for(j = 0; j < sizeof(buf); j++){
+      if(buf[j] != 'a' + i % 26){
+        printf("%s: wrong byte at %d\n", s, i * sizeof(buf) + j);
+        exit(1);
+      }
+    }
+  }
+  close(fd);
+  sysinfo(&after);
+  remove("readahead");
+
+  #ifdef RAMDISK
+  // only a ramdisk can be loaded ahead while idle
+  if(after.rabytes == before.rabytes){
+    printf("%s: no readahead\n", s);
+    exit(1);
+  }
+  #endif
+  if(after.rabytes - before.rabytes > N * sizeof(buf)){
+    printf("%s: readahead asked for %d bytes of a %d byte file\n", s,
+           after.rabytes - before.rabytes, N * sizeof(buf));
+    exit(1);
+  }
+}
+
+// two files written in turns get interleaved cluster chains,
+// longer than a dirent's extent map. both must read back.
+void
+fatfrag(char *s)
+{
+  char buf[512];
+  int fd[2], i, j, n;
+
+  fd[0] = open("fatfrag0", O_CREATE|O_RDWR);
+  fd[1] = open("fatfrag1", O_CREATE|O_RDWR);
+  if(fd[0] < 0 || fd[1] < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 64; i++){
+    for(j = 0; j < 2; j++){
+      memset(buf, 'a' + (i + j) % 26, sizeof(buf));
+      if(write(fd[j], buf, sizeof(buf)) != sizeof(buf)){
+        printf("%s: write failed\n", s);
+        exit(1);
+      }
+    }
+  }
+  close(fd[0]);
+  close(fd[1]);
+
+  for(j = 0; j < 2; j++){
+    fd[j] = open(j ? "fatfrag1" : "fatfrag0", O_RDONLY);
+    for(i = 0; (n = read(fd[j], buf, sizeof(buf))) > 0; i++){
+      if(n != sizeof(buf) || buf[0] != 'a' + (i + j) % 26
+         || buf[sizeof(buf) - 1] != buf[0]){
+        printf("%s: file %d block %d wrong\n", s, j, i);
+        exit(1);
+      }
+    }
+    close(fd[j]);
+    if(i != 64){
+      printf("%s: file %d has %d blocks\n", s, j, i);
+      exit(1);
+    }
+  }
+  remove("fatfrag0");
+  remove("fatfrag1");
+}
+
+// writing a file takes free clusters, removing it gives
+// them back.
+void
+clusfree(char *s)
+{
+  struct sysinfo before, mid, after;
+  char buf[512];
+  int fd, i;
+
+  sysinfo(&before);
+  if(before.nfreeclus == 0 || before.nfreeclus > before.nclus){
+    printf("%s: %d free of %d clusters\n", s, before.nfreeclus, before.nclus);
+    exit(1);
+  }
+  fd = open("clusfree", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  memset(buf, 'c', sizeof(buf));
+  for(i = 0; i < 16; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+  sysinfo(&mid);
+  remove("clusfree");
+  sysinfo(&after);
+
+  if(mid.nfreeclus >= before.nfreeclus){
+    printf("%s: writing took no clusters\n", s);
+    exit(1);
+  }
+  if(after.nfreeclus != before.nfreeclus){
+    printf("%s: %d free clusters before, %d after\n", s,
+           before.nfreeclus, after.nfreeclus);
+    exit(1);
+  }
+}
+
+// repeated lookups of a name, present or missing, are served
+// by the entry cache; creating a missing name must be seen.
+void
+ecachestat(char *s)
+{
+  struct sysinfo before, after;
+  int fd;
+
+  remove("ecachestat");
+  open("ecachestat", O_RDONLY);
+  sysinfo(&before);
+  if(open("ecachestat", O_RDONLY) >= 0){
+    printf("%s: opened a missing file\n", s);
+    exit(1);
+  }
+  sysinfo(&after);
+  if(after.eneghits != before.eneghits + 1){
+    printf("%s: missing name not cached\n", s);
+    exit(1);
+  }
+
+  fd = open("ecachestat", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  sysinfo(&before);
+  fd = open("ecachestat", O_RDONLY);
+  if(fd < 0){
+    printf("%s: created file not found\n", s);
+    exit(1);
+  }
+  close(fd);
+  sysinfo(&after);
+  if(after.ehits <= before.ehits || after.emisses != before.emisses){
+    printf("%s: created file not cached\n", s);
+    exit(1);
+  }
+
+  if(rename("ecachestat", "ecachestat2") < 0 || open("ecachestat", O_RDONLY) >= 0){
+    printf("%s: old name still there after rename\n", s);
+    exit(1);
+  }
+  fd = open("ecachestat2", O_RDONLY);
+  if(fd < 0){
+    printf("%s: new name missing after rename\n", s);
+    exit(1);
+  }
+  close(fd);
+  remove("ecachestat2");
+}
+
+// getdents returns every entry of a directory exactly once,
+// whatever the buffer size, and the same ones as readdir.
+void
+getdentstest(char *s)
+{
+  enum { N = 20 };
+  char name[N];       // file i holds the first i bytes of its name
+  uint64 buf[8];
+  int seen[N];
+  struct stat st;
+  struct dent *d;
+  int fd, i, n, bufsize, nread;
+
+  if(mkdir("gdents") < 0){
+    printf("%s: mkdir failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    strcpy(name, "gdents/f00");
+    name[8] = '0' + i / 10;
+    name[9] = '0' + i % 10;
+    fd = open(name, O_CREATE|O_RDWR);
+    if(fd < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    write(fd, name, i);
+    close(fd);
+  }
+
+  for(bufsize = DENTSIZE(3); bufsize <= sizeof(buf); bufsize += sizeof(buf) - DENTSIZE(3)){
+    memset(seen, 0, sizeof(seen));
+    fd = open("gdents", O_RDONLY);
+    while((n = getdents(fd, (struct dent *)buf, bufsize)) > 0){
+      for(d = (struct dent *)buf; (char *)d < (char *)buf + n; d = (struct dent *)((char *)d + d->reclen)){
+        if(d->name[0] != 'f')
+          continue;
+        i = (d->name[1] - '0') * 10 + d->name[2] - '0';
+        if(i < 0 || i >= N || d->type != T_FILE || d->size != i){
+          printf("%s: bad entry %s\n", s, d->name);
+          exit(1);
+        }
+        seen[i]++;
+      }
+    }
+    close(fd);
+    if(n < 0){
+      printf("%s: getdents failed\n", s);
+      exit(1);
+    }
+    for(i = 0; i < N; i++){
+      if(seen[i] != 1){
+        printf("%s: f%d seen %d times with %d byte buffer\n", s, i, seen[i], bufsize);
+        exit(1);
+      }
+    }
+  }
+
+  nread = 0;
+  fd = open("gdents", O_RDONLY);
+  while(readdir(fd, &st) == 1)
+    if(st.name[0] == 'f')
+      nread++;
+  close(fd);
+  if(nread != N){
+    printf("%s: readdir found %d entries\n", s, nread);
+    exit(1);
+  }
+
+  for(i = 0; i < N; i++){
+    strcpy(name, "gdents/f00");
+    name[8] = '0' + i / 10;
+    name[9] = '0' + i % 10;
+    remove(name);
+  }
+  remove("gdents");
+}
+
+// creates, removes and lookups in a directory with many names
+// must agree with each other, reused slots included.
+void
+dirindex(char *s)
+{
+  enum { N = 40 };
+  char name[32];
+  uint64 buf[64];
+  struct dent *d;
+  struct sysinfo before, after;
+  int fd, i, n, count;
+
+  if(mkdir("dindex") < 0){
+    printf("%s: mkdir failed\n", s);
+    exit(1);
+  }
+  strcpy(name, "dindex/file00");
+  for(i = 0; i < N; i++){
+    name[11] = '0' + i / 10;
+    name[12] = '0' + i % 10;
+    if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+  }
+  // free every other one, then fill the holes with other names
+  // of the same length, which must reuse them
+  sysinfo(&before);
+  for(i = 0; i < N; i += 2){
+    name[11] = '0' + i / 10;
+    name[12] = '0' + i % 10;
+    if(remove(name) < 0){
+      printf("%s: remove %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  strcpy(name, "dindex/new00");
+  for(i = 0; i < N / 2; i++){
+    name[10] = '0' + i / 10;
+    name[11] = '0' + i % 10;
+    if((fd = open(name, O_CREATE|O_RDWR)) < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+  }
+  sysinfo(&after);
+  if(after.nfreeclus != before.nfreeclus){
+    printf("%s: directory grew by %d clusters\n", s, before.nfreeclus - after.nfreeclus);
+    exit(1);
+  }
+
+  strcpy(name, "dindex/file00");
+  for(i = 0; i < N; i++){
+    name[11] = '0' + i / 10;
+    name[12] = '0' + i % 10;
+    fd = open(name, O_RDONLY);
+    if((fd >= 0) != (i % 2 == 1)){
+      printf("%s: %s %s\n", s, name, fd >= 0 ? "still there" : "missing");
+      exit(1);
+    }
+    if(fd >= 0)
+      close(fd);
+  }
+  count = 0;
+  fd = open("dindex", O_RDONLY);
+  while((n = getdents(fd, (struct dent *)buf, sizeof(buf))) > 0)
+    for(d = (struct dent *)buf; (char *)d < (char *)buf + n; d = (struct dent *)((char *)d + d->reclen))
+      if(d->name[0] != '.'){
+        if((d->name[0] == 'n') != (count % 2 == 0)){
+          printf("%s: %s is not in a freed slot\n", s, d->name);
+          exit(1);
+        }
+        count++;
+      }
+  close(fd);
+  if(count != N){
+    printf("%s: %d names in the directory\n", s, count);
+    exit(1);
+  }
+
+  for(i = 0; i < N; i++){
+    if(i % 2){
+      strcpy(name, "dindex/file00");
+      name[11] = '0' + i / 10;
+      name[12] = '0' + i % 10;
+    } else {
+      strcpy(name, "dindex/new00");
+      name[10] = '0' + i / 20;
+      name[11] = '0' + i / 2 % 10;
+    }
+    remove(name);
+  }
+  if(remove("dindex") < 0){
+    printf("%s: directory not empty\n", s);
+    exit(1);
+  }
+}
+
+// lseek, pread and pwrite reach records in the middle of a
+// file; pread and pwrite leave the file offset alone.
+void
+lseektest(char *s)
+{
+  enum { RECSZ = 100, NREC = 30 };
+  char rec[RECSZ], got[RECSZ];
+  int fd, i, fds[2];
+
+  fd = open("lseek", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NREC; i++){
+    memset(rec, 'A' + i % 26, RECSZ);
+    write(fd, rec, RECSZ);
+  }
+
+  if(lseek(fd, 0, SEEK_CUR) != RECSZ * NREC || lseek(fd, 0, SEEK_END) != RECSZ * NREC){
+    printf("%s: wrong offset after writes\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 17 * RECSZ, SEEK_SET) != 17 * RECSZ
+     || read(fd, got, RECSZ) != RECSZ || got[0] != 'A' + 17 || got[RECSZ - 1] != 'A' + 17){
+    printf("%s: read after SEEK_SET wrong\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -2 * RECSZ, SEEK_CUR) != 16 * RECSZ
+     || read(fd, got, 1) != 1 || got[0] != 'A' + 16){
+    printf("%s: read after SEEK_CUR wrong\n", s);
+    exit(1);
+  }
+
+  memset(rec, 'z', RECSZ);
+  if(pwrite(fd, rec, RECSZ, 3 * RECSZ) != RECSZ){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, got, RECSZ, 3 * RECSZ) != RECSZ || got[0] != 'z' || got[RECSZ - 1] != 'z'){
+    printf("%s: pread did not see pwrite\n", s);
+    exit(1);
+  }
+  if(pread(fd, got, RECSZ, 4 * RECSZ) != RECSZ || got[0] != 'A' + 4){
+    printf("%s: pwrite spilled into the next record\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_CUR) != 16 * RECSZ + 1){
+    printf("%s: pread/pwrite moved the offset\n", s);
+    exit(1);
+  }
+
+  if(lseek(fd, -1, SEEK_SET) >= 0 || lseek(fd, 0x100000000L, SEEK_SET) >= 0
+     || pread(fd, got, 1, 0x100000000L) >= 0){
+    printf("%s: offset out of range accepted\n", s);
+    exit(1);
+  }
+  close(fd);
+  remove("lseek");
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(lseek(fds[0], 0, SEEK_SET) >= 0 || pread(fds[0], got, 1, 0) >= 0){
+    printf("%s: seek on a pipe\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  // directories only seek to whole entries
+  fd = open(".", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open . failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 5, SEEK_SET) >= 0 || lseek(fd, 0, SEEK_CUR) != 0){
+    printf("%s: misaligned directory seek accepted\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 64, SEEK_SET) != 64 || lseek(fd, 0, SEEK_SET) != 0){
+    printf("%s: directory seek failed\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// the per-order free block counts and the zeroed pages
+// must add up to the free memory.
+void
+buddyinfo(char *s)
+{
+  struct sysinfo info;
+  uint64 pages = 0;
+
+  if(sysinfo(&info) < 0){
+    printf("%s: sysinfo failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < NORDER; i++)
+    pages += info.nfree[i] << i;
+  pages += info.nzero;
+  if(pages * PGSIZE != info.freemem){
+    printf("%s: %d free pages in blocks, freemem %d\n", s, pages, info.freemem);
+    exit(1);
+  }
+}
+
 // allocate all mem, free it, and allocate again
 void
 mem(char *s)
@@ -2083,6 +2937,50 @@ sbrkmuch(char *s)
   }
 }
 
+// does a large sbrk() hand out zeroed memory, both when
+// the process touches it and when the kernel reads or writes
+// pages the process never touched (lazy allocation)?
+void
+sbrksparse(char *s)
+{
+  enum { BIG=16*1024*1024 };
+  int fds[2];
+  char *a, *p;
+
+  a = sbrk(BIG);
+  if(a == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(p = a; p < a + BIG; p += 64*PGSIZE){
+    if(*p != 0){
+      printf("%s: page not zeroed\n", s);
+      exit(1);
+    }
+    *p = 1;
+  }
+
+  // kernel copyin from and copyout to untouched pages
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], a + BIG - 2*PGSIZE, 8) != 8 ||
+     read(fds[0], a + BIG - PGSIZE, 8) != 8){
+    printf("%s: pipe io on untouched heap failed\n", s);
+    exit(1);
+  }
+  for(p = a + BIG - PGSIZE; p < a + BIG - PGSIZE + 8; p++){
+    if(*p != 0){
+      printf("%s: wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  sbrk(-BIG);
+}
+
 // can we read the kernel's memory?
 void
 kernmem(char *s)
@@ -2675,11 +3573,15 @@ main(int argc, char *argv[])
     {fourfiles, "fourfiles"},
     {sharedfd, "sharedfd"},
     {exectest, "exectest"},
+    {textcache, "textcache"},
+    {textbusy, "textbusy"},
+    {stdiobuf, "stdiobuf"},
     {bigargtest, "bigargtest"},
     {bigwrite, "bigwrite"},
     {bsstest, "bsstest"},
     {sbrkbasic, "sbrkbasic"},
     {sbrkmuch, "sbrkmuch"},
+    {sbrksparse, "sbrksparse"},
     {kernmem, "kernmem"},
     {sbrkfail, "sbrkfail"},
     {sbrkarg, "sbrkarg"},
@@ -2694,6 +3596,8 @@ main(int argc, char *argv[])
     {iputtest, "iput"},
     {mem, "mem"},
     {pipe1, "pipe1"},
+    {pipemany, "pipemany"},
+    {pipebig, "pipebig"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
@@ -2702,6 +3606,17 @@ main(int argc, char *argv[])
     {dirfile, "dirfile"},
     {iref, "iref"},
     {forktest, "forktest"},
+    {cowfork, "cowfork"},
+    {buddyinfo, "buddyinfo"},
+    {bcachestat, "bcachestat"},
+    {writeback, "writeback"},
+    {readahead, "readahead"},
+    {fatfrag, "fatfrag"},
+    {clusfree, "clusfree"},
+    {ecachestat, "ecachestat"},
+    {getdentstest, "getdents"},
+    {dirindex, "dirindex"},
+    {lseektest, "lseek"},
               // {bigdir, "bigdir"}, // slow
     { 0, 0},
   };
@@ -6,24 +6,26 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/include/sysnum.h\"\n";
 
+# entry("name", "symbol") exports the stub under another symbol
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
-entry("close");
+entry("close", "_close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("fstat");
 entry("mkdir");
@@ -47,3 +49,8 @@ entry("frame");
 # Consti was here 06.05.2025
 entry("pmu_setup");
 entry("pmu_control");
+entry("pipe2");
+entry("getdents");
+entry("lseek");
+entry("pread");
+entry("pwrite");